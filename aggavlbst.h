@@ -0,0 +1,1021 @@
+#ifndef AGGAVLBST_H
+#define AGGAVLBST_H
+
+#include <algorithm>
+#include <limits>
+#include "avlbst.h"
+
+/**
+* Aggregation policies for AggregateAVLTree. A policy names the type it
+* produces and supplies an identity, a way to turn one value into an
+* aggregate (lift) and an associative combine. combine is always called
+* with the left operand covering smaller keys, so it does not need to
+* be commutative.
+*/
+template <typename Value>
+struct SumAggregate
+{
+    typedef Value value_type;
+    static Value identity() { return Value(); }
+    static Value lift(const Value& value) { return value; }
+    static Value combine(const Value& lhs, const Value& rhs) { return lhs + rhs; }
+};
+
+template <typename Value>
+struct MinAggregate
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::max(); }
+    static Value lift(const Value& value) { return value; }
+    static Value combine(const Value& lhs, const Value& rhs) { return std::min(lhs, rhs); }
+};
+
+template <typename Value>
+struct MaxAggregate
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::lowest(); }
+    static Value lift(const Value& value) { return value; }
+    static Value combine(const Value& lhs, const Value& rhs) { return std::max(lhs, rhs); }
+};
+
+/**
+* An AVL node that also stores the aggregate of the values in its
+* subtree, as defined by the policy Aggregate.
+*/
+template <typename Key, typename Value, typename Aggregate>
+class AggregateAVLNode : public AVLNode<Key, Value>
+{
+public:
+    typedef typename Aggregate::value_type aggregate_type;
+
+    // Constructor/destructor.
+    AggregateAVLNode(const Key& key, const Value& value, AggregateAVLNode<Key, Value, Aggregate>* parent);
+    template<typename... Args>
+    AggregateAVLNode(AggregateAVLNode<Key, Value, Aggregate>* parent, Args&&... args);
+    ~AggregateAVLNode();
+
+    // Getter/setter for the aggregate of this subtree.
+    const aggregate_type& getAggregate() const;
+    void setAggregate(const aggregate_type& aggregate);
+
+    // Redefined for the same reason as in AVLNode.
+    AggregateAVLNode<Key, Value, Aggregate>* getParent() const;
+    AggregateAVLNode<Key, Value, Aggregate>* getLeft() const;
+    AggregateAVLNode<Key, Value, Aggregate>* getRight() const;
+
+protected:
+    aggregate_type aggregate_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the AggregateAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node aggregates just its own value.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLNode<Key, Value, Aggregate>::AggregateAVLNode(const Key& key, const Value& value, AggregateAVLNode<Key, Value, Aggregate> *parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(Aggregate::lift(value))
+{
+
+}
+
+/**
+* Constructs the item in place; see Node. The value is lifted once the
+* item exists, since it may have been moved in.
+*/
+template<class Key, class Value, class Aggregate>
+template<typename... Args>
+AggregateAVLNode<Key, Value, Aggregate>::AggregateAVLNode(AggregateAVLNode<Key, Value, Aggregate> *parent, Args&&... args) :
+    AVLNode<Key, Value>(parent, std::forward<Args>(args)...), aggregate_(Aggregate::lift(this->item_.second))
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLNode<Key, Value, Aggregate>::~AggregateAVLNode()
+{
+
+}
+
+/**
+* A getter for the subtree aggregate of an AggregateAVLNode.
+*/
+template<class Key, class Value, class Aggregate>
+const typename AggregateAVLNode<Key, Value, Aggregate>::aggregate_type&
+AggregateAVLNode<Key, Value, Aggregate>::getAggregate() const
+{
+    return aggregate_;
+}
+
+/**
+* A setter for the subtree aggregate of an AggregateAVLNode.
+*/
+template<class Key, class Value, class Aggregate>
+void AggregateAVLNode<Key, Value, Aggregate>::setAggregate(const aggregate_type& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+/**
+* Redefined so that callers get an AggregateAVLNode back without a cast.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLNode<Key, Value, Aggregate> *AggregateAVLNode<Key, Value, Aggregate>::getParent() const
+{
+    return static_cast<AggregateAVLNode<Key, Value, Aggregate>*>(this->parent_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLNode<Key, Value, Aggregate> *AggregateAVLNode<Key, Value, Aggregate>::getLeft() const
+{
+    return static_cast<AggregateAVLNode<Key, Value, Aggregate>*>(this->left_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLNode<Key, Value, Aggregate> *AggregateAVLNode<Key, Value, Aggregate>::getRight() const
+{
+    return static_cast<AggregateAVLNode<Key, Value, Aggregate>*>(this->right_);
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the AggregateAVLNode class.
+  --------------------------------------------------
+*/
+
+/**
+* An AVL tree that keeps, in every node, the aggregate of the values in
+* its subtree, so aggregate(lo, hi) costs O(log n). Aggregates are kept
+* up to date by insert, remove, the rotations, nodeSwap and the join
+* helpers through the updateNode/updatePath/updateValue hooks.
+*
+* Values can only change through the tree: operator[], find_or_insert,
+* the inserts, emplaces, iterators and ranges hand out a value_reference,
+* which refreshes the path to the root whenever it is assigned to, and
+* update refreshes it after calling its functor.
+*/
+template <class Key, class Value, class Aggregate = SumAggregate<Value> >
+class AggregateAVLTree : public AVLTree<Key, Value, std::less<Key>, AggregateAVLTree<Key, Value, Aggregate> >
+{
+protected:
+    typedef AVLTree<Key, Value, std::less<Key>, AggregateAVLTree<Key, Value, Aggregate> > Base;
+    typedef AggregateAVLNode<Key, Value, Aggregate> AggNode;
+    friend class BinarySearchTree<Key, Value>;
+    friend class AVLTree<Key, Value, std::less<Key>, AggregateAVLTree<Key, Value, Aggregate> >;
+    typedef typename BinarySearchTree<Key, Value>::iterator BaseIterator;
+
+public:
+    typedef typename Aggregate::value_type aggregate_type;
+
+    /**
+    * Stands in for a Value& into the tree. Reading converts to the value;
+    * assigning stores the new value and refreshes the aggregates above it.
+    */
+    class value_reference
+    {
+    public:
+        operator const Value&() const;
+        value_reference& operator=(const Value& value);
+        value_reference& operator=(const value_reference& other);
+        value_reference& operator+=(const Value& value);
+        value_reference& operator-=(const Value& value);
+        value_reference& operator*=(const Value& value);
+        value_reference& operator/=(const Value& value);
+        value_reference& operator%=(const Value& value);
+        value_reference& operator&=(const Value& value);
+        value_reference& operator|=(const Value& value);
+        value_reference& operator^=(const Value& value);
+        value_reference& operator<<=(const Value& value);
+        value_reference& operator>>=(const Value& value);
+        value_reference& operator++();
+        Value operator++(int);
+        value_reference& operator--();
+        Value operator--(int);
+
+    protected:
+        friend class AggregateAVLTree<Key, Value, Aggregate>;
+        value_reference(Node<Key, Value>* node);
+        Node<Key, Value>* node_;
+    };
+
+    /**
+    * What an iterator points at: the key and a value_reference.
+    */
+    struct item_reference
+    {
+        item_reference(Node<Key, Value>* node);
+        item_reference* operator->();
+
+        const Key& first;
+        value_reference second;
+    };
+
+    /**
+    * An iterator over the tree that returns item_reference instead of
+    * the stored pair, so that writes through it keep aggregates correct.
+    */
+    class iterator : public BaseIterator
+    {
+    public:
+        typedef item_reference reference;
+        typedef item_reference pointer;
+
+        iterator();
+        iterator(const BaseIterator& it);
+
+        item_reference operator*() const;
+        item_reference operator->() const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class AggregateAVLTree<Key, Value, Aggregate>;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
+    /**
+    * Same as BinarySearchTree::iterator_range, with this tree's iterator.
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    AggregateAVLTree();
+    template<typename ForwardIt>
+    AggregateAVLTree(ForwardIt first, ForwardIt last);
+    AggregateAVLTree(const AggregateAVLTree<Key, Value, Aggregate>& other);
+    AggregateAVLTree(AggregateAVLTree<Key, Value, Aggregate>&& other);
+    virtual ~AggregateAVLTree();
+    AggregateAVLTree<Key, Value, Aggregate>& operator=(AggregateAVLTree<Key, Value, Aggregate> other);
+    AggregateAVLTree<Key, Value, Aggregate> clone(unsigned int threads = 1) const;
+
+    aggregate_type aggregate() const;
+    aggregate_type aggregate(const Key& lo, const Key& hi) const;
+
+    iterator begin() const;
+    iterator end() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    value_reference operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+    const Value* get(const Key& key) const;
+    std::pair<value_reference, bool> find_or_insert(const Key& key, const Value& value = Value());
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void insert(std::pair<const Key, Value>&& keyValuePair);
+    iterator insert(iterator hint, const std::pair<const Key, Value>& keyValuePair);
+    iterator insert(iterator hint, std::pair<const Key, Value>&& keyValuePair);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& obj);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, M&& obj);
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+
+protected:
+    void nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    Node<Key, Value>* cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent);
+    void destroyNode(Node<Key, Value>* curr);
+    void updateNode(Node<Key, Value>* curr);
+    void updatePath(Node<Key, Value>* curr);
+    void updateValue(Node<Key, Value>* curr);
+    bool trivialNodes() const;
+    static void refresh(Node<Key, Value>* curr);
+    static void refreshPath(Node<Key, Value>* curr);
+    static aggregate_type subtreeAggregate(Node<Key, Value>* curr);
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the AggregateAVLTree helper classes.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::value_reference(Node<Key, Value>* node) :
+    node_(node)
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator const Value&() const
+{
+    return node_->getValue();
+}
+
+/**
+* Stores value and refreshes the aggregates from this node to the root.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator=(const Value& value)
+{
+    node_->setValue(value);
+    refreshPath(node_);
+    return *this;
+}
+
+/**
+* Assigns the value other refers to, not the reference itself.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator=(const value_reference& other)
+{
+    return (*this) = static_cast<const Value&>(other);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator+=(const Value& value)
+{
+    return (*this) = (node_->getValue()) + value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator-=(const Value& value)
+{
+    return (*this) = (node_->getValue()) - value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator*=(const Value& value)
+{
+    return (*this) = (node_->getValue()) * value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator/=(const Value& value)
+{
+    return (*this) = (node_->getValue()) / value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator%=(const Value& value)
+{
+    return (*this) = (node_->getValue()) % value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator&=(const Value& value)
+{
+    return (*this) = (node_->getValue()) & value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator|=(const Value& value)
+{
+    return (*this) = (node_->getValue()) | value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator^=(const Value& value)
+{
+    return (*this) = (node_->getValue()) ^ value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator<<=(const Value& value)
+{
+    return (*this) = (node_->getValue()) << value;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator>>=(const Value& value)
+{
+    return (*this) = (node_->getValue()) >> value;
+}
+
+/**
+* Steps a copy of the value and stores it, so the aggregates are
+* refreshed as for any other assignment.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator++()
+{
+    Value value = node_->getValue();
+    ++value;
+    return (*this) = value;
+}
+
+/**
+* As the prefix form, returning the value from before.
+*/
+template<class Key, class Value, class Aggregate>
+Value AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator++(int)
+{
+    Value old = node_->getValue();
+    ++(*this);
+    return old;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference&
+AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator--()
+{
+    Value value = node_->getValue();
+    --value;
+    return (*this) = value;
+}
+
+template<class Key, class Value, class Aggregate>
+Value AggregateAVLTree<Key, Value, Aggregate>::value_reference::operator--(int)
+{
+    Value old = node_->getValue();
+    --(*this);
+    return old;
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::item_reference::item_reference(Node<Key, Value>* node) :
+    first(node->getKey()),
+    second(node)
+{
+
+}
+
+/**
+* Lets iterator::operator-> return an item_reference by value.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::item_reference*
+AggregateAVLTree<Key, Value, Aggregate>::item_reference::operator->()
+{
+    return this;
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::iterator::iterator() : BaseIterator()
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::iterator::iterator(const BaseIterator& it) : BaseIterator(it)
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::item_reference
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator*() const
+{
+    return item_reference(this->current_);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::item_reference
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator->() const
+{
+    return item_reference(this->current_);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator&
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator++()
+{
+    BaseIterator::operator++();
+    return (*this);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator++(int)
+{
+    iterator old(*this);
+    BaseIterator::operator++();
+    return old;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator&
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator--()
+{
+    BaseIterator::operator--();
+    return (*this);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::iterator::operator--(int)
+{
+    iterator old(*this);
+    BaseIterator::operator--();
+    return old;
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::iterator_range::end() const
+{
+    return last_;
+}
+
+template<class Key, class Value, class Aggregate>
+bool AggregateAVLTree<Key, Value, Aggregate>::iterator_range::empty() const
+{
+    return first_.current_ == last_.current_;
+}
+
+/*
+------------------------------------------------------------
+End implementations for the AggregateAVLTree helper classes.
+------------------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::AggregateAVLTree() : Base()
+{
+
+}
+
+/**
+* Builds the tree from a range sorted by strictly increasing key, in O(n).
+*/
+template<class Key, class Value, class Aggregate>
+template<typename ForwardIt>
+AggregateAVLTree<Key, Value, Aggregate>::AggregateAVLTree(ForwardIt first, ForwardIt last) : Base()
+{
+    this->assign(first, last);
+}
+
+/**
+* A deep copy of other with the same shape, made once this tree's hooks
+* exist.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::AggregateAVLTree(const AggregateAVLTree<Key, Value, Aggregate>& other) : Base()
+{
+    Base::cloneWith(*this, other, 1);
+}
+
+/**
+* Takes over other's nodes in O(1), leaving other empty.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::AggregateAVLTree(AggregateAVLTree<Key, Value, Aggregate>&& other) : Base(std::move(other))
+{
+
+}
+
+/**
+* Clears here rather than in the base destructor, which could no longer
+* see that aggregates may need destroying.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::~AggregateAVLTree()
+{
+    this->clear();
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>& AggregateAVLTree<Key, Value, Aggregate>::operator=(AggregateAVLTree<Key, Value, Aggregate> other)
+{
+    this->swap(other);
+    return *this;
+}
+
+/**
+* Returns a copy of the tree, as AVLTree::clone.
+*/
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate> AggregateAVLTree<Key, Value, Aggregate>::clone(unsigned int threads) const
+{
+    AggregateAVLTree<Key, Value, Aggregate> copy;
+    Base::cloneWith(copy, *this, threads);
+    return copy;
+}
+
+/**
+* Returns the aggregate of every value in the tree, in O(1).
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::aggregate_type
+AggregateAVLTree<Key, Value, Aggregate>::aggregate() const
+{
+    return subtreeAggregate(this->root_);
+}
+
+/**
+* Returns the aggregate of the values whose keys satisfy lo <= key < hi,
+* in key order, or the identity if there are none. We descend to the
+* first node inside the range (where the paths to lo and hi split) and
+* then follow each boundary down once, taking whole subtrees that lie
+* inside the range, so this is O(log n).
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::aggregate_type
+AggregateAVLTree<Key, Value, Aggregate>::aggregate(const Key& lo, const Key& hi) const
+{
+    AggNode* fork = static_cast<AggNode*>(this->root_);
+    while(fork != nullptr){
+        if((fork->getKey()) < lo){
+            fork = fork->getRight();
+        }
+        else if(!((fork->getKey()) < hi)){
+            fork = fork->getLeft();
+        }
+        else{
+            break;
+        }
+    }
+    if(fork == nullptr){
+        return Aggregate::identity();
+    }
+
+    aggregate_type leftPart = Aggregate::identity();
+    AggNode* curr = fork->getLeft();
+    while(curr != nullptr){
+        if((curr->getKey()) < lo){
+            curr = curr->getRight();
+        }
+        else{
+            leftPart = Aggregate::combine(Aggregate::combine(Aggregate::lift(curr->getValue()),
+                subtreeAggregate(curr->getRight())), leftPart);
+            curr = curr->getLeft();
+        }
+    }
+
+    aggregate_type rightPart = Aggregate::identity();
+    curr = fork->getRight();
+    while(curr != nullptr){
+        if((curr->getKey()) < hi){
+            rightPart = Aggregate::combine(rightPart, Aggregate::combine(subtreeAggregate(curr->getLeft()),
+                Aggregate::lift(curr->getValue())));
+            curr = curr->getRight();
+        }
+        else{
+            curr = curr->getLeft();
+        }
+    }
+
+    return Aggregate::combine(Aggregate::combine(leftPart, Aggregate::lift(fork->getValue())), rightPart);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::begin() const
+{
+    return iterator(Base::begin());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::end() const
+{
+    return iterator(Base::end());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::reverse_iterator
+AggregateAVLTree<Key, Value, Aggregate>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::reverse_iterator
+AggregateAVLTree<Key, Value, Aggregate>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::find(const Key& key) const
+{
+    return iterator(Base::find(key));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::lower_bound(const Key& key) const
+{
+    return iterator(Base::lower_bound(key));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::upper_bound(const Key& key) const
+{
+    return iterator(Base::upper_bound(key));
+}
+
+template<class Key, class Value, class Aggregate>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, typename AggregateAVLTree<Key, Value, Aggregate>::iterator>
+AggregateAVLTree<Key, Value, Aggregate>::equal_range(const Key& key) const
+{
+    std::pair<BaseIterator, BaseIterator> found = Base::equal_range(key);
+    return std::make_pair(iterator(found.first), iterator(found.second));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator_range
+AggregateAVLTree<Key, Value, Aggregate>::range(const Key& lo, const Key& hi) const
+{
+    typename Base::iterator_range found = Base::range(lo, hi);
+    return iterator_range(iterator(found.begin()), iterator(found.end()));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns a reference to the value associated with the key; assigning
+ * through it refreshes the aggregates.
+ */
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::value_reference
+AggregateAVLTree<Key, Value, Aggregate>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = this->internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return value_reference(curr);
+}
+
+template<class Key, class Value, class Aggregate>
+Value const & AggregateAVLTree<Key, Value, Aggregate>::operator[](const Key& key) const
+{
+    return Base::operator[](key);
+}
+
+/**
+* As BinarySearchTree::get, but read-only even on a non-const tree;
+* values change through operator[], find_or_insert or update.
+*/
+template<class Key, class Value, class Aggregate>
+const Value* AggregateAVLTree<Key, Value, Aggregate>::get(const Key& key) const
+{
+    return Base::get(key);
+}
+
+/**
+* As BinarySearchTree::find_or_insert, handing out a value_reference.
+*/
+template<class Key, class Value, class Aggregate>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::value_reference, bool>
+AggregateAVLTree<Key, Value, Aggregate>::find_or_insert(const Key& key, const Value& value)
+{
+    std::pair<Node<Key, Value>*, bool> result = Base::findOrInsertWith(*this, key, value);
+    return std::make_pair(value_reference(result.first), result.second);
+}
+
+/*
+* The inserts below are AVLTree's; they are declared again so that the
+* ones returning an iterator return this tree's, through which writes
+* refresh the aggregates. The plain inserts only need redeclaring
+* because the others would hide them.
+*/
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Base::insert(keyValuePair);
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    Base::insert(std::move(keyValuePair));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::insert(iterator hint, const std::pair<const Key, Value>& keyValuePair)
+{
+    return iterator(Base::insert(hint, keyValuePair));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::insert(iterator hint, std::pair<const Key, Value>&& keyValuePair)
+{
+    return iterator(Base::insert(hint, std::move(keyValuePair)));
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename... Args>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, bool>
+AggregateAVLTree<Key, Value, Aggregate>::emplace(Args&&... args)
+{
+    std::pair<BaseIterator, bool> result = Base::emplace(std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename... Args>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, bool>
+AggregateAVLTree<Key, Value, Aggregate>::try_emplace(const Key& key, Args&&... args)
+{
+    std::pair<BaseIterator, bool> result = Base::try_emplace(key, std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename... Args>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, bool>
+AggregateAVLTree<Key, Value, Aggregate>::try_emplace(Key&& key, Args&&... args)
+{
+    std::pair<BaseIterator, bool> result = Base::try_emplace(std::move(key), std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename M>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, bool>
+AggregateAVLTree<Key, Value, Aggregate>::insert_or_assign(const Key& key, M&& obj)
+{
+    std::pair<BaseIterator, bool> result = Base::insert_or_assign(key, std::forward<M>(obj));
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename M>
+std::pair<typename AggregateAVLTree<Key, Value, Aggregate>::iterator, bool>
+AggregateAVLTree<Key, Value, Aggregate>::insert_or_assign(Key&& key, M&& obj)
+{
+    std::pair<BaseIterator, bool> result = Base::insert_or_assign(std::move(key), std::forward<M>(obj));
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+/**
+* As AVLTree::erase, returning this tree's iterator.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::erase(iterator pos)
+{
+    return iterator(Base::erase(pos));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::iterator
+AggregateAVLTree<Key, Value, Aggregate>::erase(iterator first, iterator last)
+{
+    return iterator(Base::erase(first, last));
+}
+
+/**
+* Aggregates describe positions in the tree, so they are swapped back
+* along with the balances. remove refreshes the path afterwards.
+*/
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    Base::nodeSwap(n1, n2);
+    AggNode* a1 = static_cast<AggNode*>(n1);
+    AggNode* a2 = static_cast<AggNode*>(n2);
+    aggregate_type tempA = a1->getAggregate();
+    a1->setAggregate(a2->getAggregate());
+    a2->setAggregate(tempA);
+}
+
+template<class Key, class Value, class Aggregate>
+template<typename... Args>
+Node<Key, Value>* AggregateAVLTree<Key, Value, Aggregate>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (this->template allocateNode<AggNode>()) AggNode(static_cast<AggNode*>(parent), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Aggregate>
+Node<Key, Value>* AggregateAVLTree<Key, Value, Aggregate>::cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* curr = Base::cloneNode(src, parent);
+    static_cast<AggNode*>(curr)->setAggregate(static_cast<AggNode*>(src)->getAggregate());
+    return curr;
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::destroyNode(Node<Key, Value>* curr)
+{
+    this->freeNode(static_cast<AggNode*>(curr));
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::updateNode(Node<Key, Value>* curr)
+{
+    refresh(curr);
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::updatePath(Node<Key, Value>* curr)
+{
+    refreshPath(curr);
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::updateValue(Node<Key, Value>* curr)
+{
+    refreshPath(curr);
+}
+
+/**
+* Nodes also hold an aggregate, which must be trivially destructible too
+* for clear() to skip visiting them.
+*/
+template<class Key, class Value, class Aggregate>
+bool AggregateAVLTree<Key, Value, Aggregate>::trivialNodes() const
+{
+    return Base::trivialNodes() && std::is_trivially_destructible<aggregate_type>::value;
+}
+
+/**
+* Recomputes the aggregate of curr from its value and its children.
+* Static so that value_reference can use it without the tree.
+*/
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::refresh(Node<Key, Value>* curr)
+{
+    static_cast<AggNode*>(curr)->setAggregate(Aggregate::combine(Aggregate::combine(
+        subtreeAggregate(curr->getLeft()), Aggregate::lift(curr->getValue())), subtreeAggregate(curr->getRight())));
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::refreshPath(Node<Key, Value>* curr)
+{
+    while(curr != nullptr){
+        refresh(curr);
+        curr = curr->getParent();
+    }
+}
+
+/**
+* The aggregate of the subtree at curr, the identity for an empty one.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::aggregate_type
+AggregateAVLTree<Key, Value, Aggregate>::subtreeAggregate(Node<Key, Value>* curr)
+{
+    if(curr == nullptr){
+        return Aggregate::identity();
+    }
+    return static_cast<AggNode*>(curr)->getAggregate();
+}
+
+#endif
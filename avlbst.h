@@ -6,6 +6,10 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <future>
+#include <type_traits>
+#include <vector>
 #include "bst.h"
 
 struct KeyError { };
@@ -21,7 +25,9 @@ class AVLNode : public Node<Key, Value>
 public:
     // Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    template<typename... Args>
+    AVLNode(AVLNode<Key, Value>* parent, Args&&... args);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
@@ -31,9 +37,9 @@ public:
     // Getters for parent, left, and right. These need to be redefined since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
@@ -55,6 +61,17 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 
 }
 
+/**
+* Constructs the item in place; see Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+AVLNode<Key, Value>::AVLNode(AVLNode<Key, Value> *parent, Args&&... args) :
+    Node<Key, Value>(parent, std::forward<Args>(args)...), balance_(0)
+{
+
+}
+
 /**
 * A destructor which does nothing.
 */
@@ -92,7 +109,7 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
+* A redefined function for getting the parent since a static_cast is necessary to make sure
 * that our node is a AVLNode.
 */
 template<class Key, class Value>
@@ -102,7 +119,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Redefined for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
@@ -111,7 +128,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Redefined for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
@@ -127,144 +144,486 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+/**
+* An AVL tree, ordered by Compare as in BinarySearchTree. Trees that
+* keep more in their nodes derive from
+* AVLTree<Key, Value, Compare, TheirType>; every algorithm here calls the node
+* hooks (createNode, updateNode, ...) through self(), so the derived
+* tree's versions are used without virtual calls.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Derived = void>
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
+protected:
+    typedef typename std::conditional<std::is_void<Derived>::value, AVLTree<Key, Value, Compare, Derived>, Derived>::type Self;
+    friend class BinarySearchTree<Key, Value, Compare>;
+
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    template<typename ForwardIt>
+    AVLTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    AVLTree(const AVLTree<Key, Value, Compare, Derived>& other);
+    AVLTree(AVLTree<Key, Value, Compare, Derived>&& other);
+    virtual ~AVLTree();
+    AVLTree<Key, Value, Compare, Derived>& operator=(AVLTree<Key, Value, Compare, Derived> other);
+    void swap(AVLTree<Key, Value, Compare, Derived>& other);
+    Self clone(unsigned int threads = 1) const;
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void insert(std::pair<const Key, Value>&& keyValuePair);
+    typename BinarySearchTree<Key, Value, Compare>::iterator insert(typename BinarySearchTree<Key, Value, Compare>::iterator hint,
+                                                           const std::pair<const Key, Value>& keyValuePair);
+    typename BinarySearchTree<Key, Value, Compare>::iterator insert(typename BinarySearchTree<Key, Value, Compare>::iterator hint,
+                                                           std::pair<const Key, Value>&& keyValuePair);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> insert_or_assign(const Key& key, M&& obj);
+    template<typename M>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> insert_or_assign(Key&& key, M&& obj);
+    std::pair<Value&, bool> find_or_insert(const Key& key, const Value& value = Value());
+    template<typename F>
+    bool update(const Key& key, F fn);
+    typename BinarySearchTree<Key, Value, Compare>::iterator erase(typename BinarySearchTree<Key, Value, Compare>::iterator pos);
+    typename BinarySearchTree<Key, Value, Compare>::iterator erase(typename BinarySearchTree<Key, Value, Compare>::iterator first,
+                                                          typename BinarySearchTree<Key, Value, Compare>::iterator last);
+    template<typename Pred>
+    size_t erase_if(Pred pred);
     virtual void remove(const Key& key);  // TODO
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    void remove(const K& key);
+    virtual void clear();
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+    template<typename InputIt>
+    void assignUnsorted(InputIt first, InputIt last);
+
+    // Join-based bulk operations. These move nodes between trees instead of
+    // copying them; the trees passed in are left empty.
+    void split(const Key& key, Self& left, Self& right);
+    void join(Self& left, const std::pair<const Key, Value>& pivot, Self& right);
+    void join(Self& left, Self& right);
+    void unionWith(Self& other, unsigned int threads = 1);
+    void intersectWith(Self& other, unsigned int threads = 1);
+    void differenceWith(Self& other, unsigned int threads = 1);
 protected:
-    virtual void nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    Self& self();
+
+    // Node hooks, see BinarySearchTree.
+    void nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    Node<Key, Value>* insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* new_node);
+    void removeNode(Node<Key, Value>* node);
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    Node<Key, Value>* cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent);
+    void destroyNode(Node<Key, Value>* curr);
+    void buildFix(Node<Key, Value>* curr, int leftHeight, int rightHeight);
 
     // Add helper functions here
-    virtual void insertFix(AVLNode<Key, Value>* curr);
-    virtual void removeFix(AVLNode<Key, Value>* curr);
-    virtual void insertLeft(AVLNode<Key, Value>* pare);
-    virtual void insertRight(AVLNode<Key, Value>* pare);
-    virtual int maxHeight(AVLNode<Key, Value>* curr);
-    virtual AVLNode<Key, Value>* internalFindAVL(const Key& key) const;
-    virtual AVLNode<Key, Value>* predecessor(AVLNode<Key, Value>* current);
+    void insertFix(AVLNode<Key, Value>* prev, AVLNode<Key, Value>* curr);
+    void removeFix(AVLNode<Key, Value>* curr, int8_t diff);
+    AVLNode<Key, Value>* rebalance(AVLNode<Key, Value>* prev);
+    void insertLeft(AVLNode<Key, Value>* pare);
+    void insertRight(AVLNode<Key, Value>* pare);
+    AVLNode<Key, Value>* internalFindAVL(const Key& key) const;
+    AVLNode<Key, Value>* predecessor(AVLNode<Key, Value>* current);
+
+    // Helpers for the join-based operations. They work on detached subtrees
+    // whose heights are passed along, and never touch root_.
+    int treeHeight(AVLNode<Key, Value>* curr) const;
+    int joinFix(AVLNode<Key, Value>* prev, AVLNode<Key, Value>* curr);
+    AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+                                   AVLNode<Key, Value>* right, int rightHeight, int& height);
+    AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, int leftHeight,
+                                   AVLNode<Key, Value>* right, int rightHeight, int& height);
+    void splitNodes(AVLNode<Key, Value>* curr, int height, const Key& key,
+                    AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& mid,
+                    AVLNode<Key, Value>*& right, int& rightHeight);
+    AVLNode<Key, Value>* splitLast(AVLNode<Key, Value>* curr, int height, AVLNode<Key, Value>*& last, int& restHeight);
+    AVLNode<Key, Value>* detachChildren(AVLNode<Key, Value>* curr, int height,
+                                        AVLNode<Key, Value>*& left, int& leftHeight,
+                                        AVLNode<Key, Value>*& right, int& rightHeight);
+    AVLNode<Key, Value>* unionNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                    int& height, unsigned int threads);
+    AVLNode<Key, Value>* intersectNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                        int& height, unsigned int threads);
+    AVLNode<Key, Value>* differenceNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                         int& height, unsigned int threads);
+    AVLNode<Key, Value>* takeRoot(Self& tree, int& height);
 
 
 };
 
+/**
+* Default constructor for an empty AVL tree.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>::AVLTree() : BinarySearchTree<Key, Value, Compare>()
+{
+
+}
+
+/**
+* An empty AVL tree ordered by comp.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>::AVLTree(const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+
+}
+
+/**
+* Builds a perfectly balanced AVL tree from a range sorted by strictly
+* increasing key under comp, in O(n).
+*/
+template<class Key, class Value, class Compare, class Derived>
+template<typename ForwardIt>
+AVLTree<Key, Value, Compare, Derived>::AVLTree(ForwardIt first, ForwardIt last, const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+    this->assign(first, last);
+}
+
+/**
+* A deep copy of other with the same shape and balances, in O(n); see
+* BinarySearchTree::cloneWith. Like the range constructor this calls the
+* hooks through self(), so a derived tree defines its own copy
+* constructor instead of using this one.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>::AVLTree(const AVLTree<Key, Value, Compare, Derived>& other) :
+    BinarySearchTree<Key, Value, Compare>(other.comp_)
+{
+    BinarySearchTree<Key, Value, Compare>::cloneWith(self(), static_cast<const Self&>(other), 1);
+}
+
+/**
+* Takes over other's nodes in O(1), leaving other empty.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>::AVLTree(AVLTree<Key, Value, Compare, Derived>&& other) :
+    BinarySearchTree<Key, Value, Compare>(std::move(other))
+{
+
+}
+
+/**
+* Clears with this tree's hooks; the base destructor only sees plain nodes.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>::~AVLTree()
+{
+    BinarySearchTree<Key, Value, Compare>::clearWith(*this);
+}
+
+/**
+* Copy or move assignment by swapping with other; see BinarySearchTree.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLTree<Key, Value, Compare, Derived>& AVLTree<Key, Value, Compare, Derived>::operator=(AVLTree<Key, Value, Compare, Derived> other)
+{
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees of the same kind in O(1).
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::swap(AVLTree<Key, Value, Compare, Derived>& other)
+{
+    BinarySearchTree<Key, Value, Compare>::swap(other);
+}
+
+/**
+* Returns a copy of the tree with the same shape and balances, in O(n),
+* copying large subtrees concurrently when threads > 1. Derived trees
+* that cannot be built from a Compare define their own.
+*/
+template<class Key, class Value, class Compare, class Derived>
+typename AVLTree<Key, Value, Compare, Derived>::Self AVLTree<Key, Value, Compare, Derived>::clone(unsigned int threads) const
+{
+    Self copy(this->comp_);
+    BinarySearchTree<Key, Value, Compare>::cloneWith(copy, static_cast<const Self&>(*this), threads);
+    return copy;
+}
+
+template<class Key, class Value, class Compare, class Derived>
+typename AVLTree<Key, Value, Compare, Derived>::Self& AVLTree<Key, Value, Compare, Derived>::self()
+{
+    return static_cast<Self&>(*this);
+}
+
 /*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
+ * Insertion itself (plain or hinted) is the single descent shared with
+ * BinarySearchTree, which overwrites the value when the key is already
+ * in the tree. Attaching a new leaf is where the AVL tree takes over.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    // TODO
-    if((this->root_) == nullptr){
-        (this->root_) = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-        return;
-    }
-    AVLNode<Key, Value>* curr = internalFindAVL(new_item.first);
-    if(curr != nullptr){
-        curr->setValue(new_item.second);
-        return;
-    }
-    curr = static_cast<AVLNode<Key, Value>*> (this->root_);
-    AVLNode<Key, Value>* prev = curr;
-    while(curr != nullptr){
-        prev = curr;
-        if(new_item.first < (curr->getKey())){
-            curr->updateBalance(-1);
-            curr = curr->getLeft();
-        }
-        else{
-            curr->updateBalance(1);
-            curr = curr->getRight();
-        }
-    }
-    curr = new AVLNode<Key, Value>(new_item.first, new_item.second, prev);
-    if(new_item.first < (prev->getKey())){
-        prev->setLeft(curr);
-    }
-    else{
-        prev->setRight(curr);
-    }
-    while(prev != nullptr){
-        prev->setBalance(maxHeight(prev->getRight()) - maxHeight(prev->getLeft()));
-        if(((prev->getBalance()) < -1) || ((prev->getBalance()) > 1)){
-            insertFix(prev);
-        }
-        prev = (prev->getParent());
-    }
+    BinarySearchTree<Key, Value, Compare>::insertWith(self(), keyValuePair);
 }
 
-template<class Key, class Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::internalFindAVL(const Key& key) const{
-    if((this->root_) == nullptr){
-        return nullptr;
-    }
-    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*> (this->root_);
-    while(curr != nullptr){
-        if(key == (curr->getKey())){
-            break;
-        }
-        else if(key < (curr->getKey())){
-            curr = curr->getLeft();
-        }
-        else{
-            curr = curr->getRight();
-        }
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::insert(std::pair<const Key, Value> &&keyValuePair)
+{
+    BinarySearchTree<Key, Value, Compare>::insertWith(self(), std::move(keyValuePair));
+}
+
+template<class Key, class Value, class Compare, class Derived>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare, Derived>::insert(typename BinarySearchTree<Key, Value, Compare>::iterator hint, const std::pair<const Key, Value> &keyValuePair)
+{
+    return BinarySearchTree<Key, Value, Compare>::insertWith(self(), hint, keyValuePair);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare, Derived>::insert(typename BinarySearchTree<Key, Value, Compare>::iterator hint, std::pair<const Key, Value> &&keyValuePair)
+{
+    return BinarySearchTree<Key, Value, Compare>::insertWith(self(), hint, std::move(keyValuePair));
+}
+
+/*
+ * emplace, try_emplace, insert_or_assign, find_or_insert and update are
+ * also shared with BinarySearchTree and only differ in the hooks they
+ * reach.
+ */
+template<class Key, class Value, class Compare, class Derived>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare, Derived>::emplace(Args&&... args)
+{
+    return BinarySearchTree<Key, Value, Compare>::emplaceWith(self(), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare, Derived>::try_emplace(const Key& key, Args&&... args)
+{
+    return BinarySearchTree<Key, Value, Compare>::tryEmplaceWith(self(), key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare, Derived>::try_emplace(Key&& key, Args&&... args)
+{
+    return BinarySearchTree<Key, Value, Compare>::tryEmplaceWith(self(), std::move(key), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare, Derived>::insert_or_assign(const Key& key, M&& obj)
+{
+    return BinarySearchTree<Key, Value, Compare>::insertOrAssignWith(self(), key, std::forward<M>(obj));
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare, Derived>::insert_or_assign(Key&& key, M&& obj)
+{
+    return BinarySearchTree<Key, Value, Compare>::insertOrAssignWith(self(), std::move(key), std::forward<M>(obj));
+}
+
+template<class Key, class Value, class Compare, class Derived>
+std::pair<Value&, bool> AVLTree<Key, Value, Compare, Derived>::find_or_insert(const Key& key, const Value& value)
+{
+    std::pair<Node<Key, Value>*, bool> result = BinarySearchTree<Key, Value, Compare>::findOrInsertWith(self(), key, value);
+    return std::pair<Value&, bool>(result.first->getValue(), result.second);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename F>
+bool AVLTree<Key, Value, Compare, Derived>::update(const Key& key, F fn)
+{
+    return BinarySearchTree<Key, Value, Compare>::updateWith(self(), key, fn);
+}
+
+/*
+ * erase and erase_if are shared with BinarySearchTree as well; they
+ * unlink nodes through removeNode, so every removal rebalances.
+ */
+template<class Key, class Value, class Compare, class Derived>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare, Derived>::erase(typename BinarySearchTree<Key, Value, Compare>::iterator pos)
+{
+    typename BinarySearchTree<Key, Value, Compare>::iterator next = pos;
+    ++next;
+    return BinarySearchTree<Key, Value, Compare>::eraseWith(self(), pos, next);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare, Derived>::erase(typename BinarySearchTree<Key, Value, Compare>::iterator first,
+                                             typename BinarySearchTree<Key, Value, Compare>::iterator last)
+{
+    return BinarySearchTree<Key, Value, Compare>::eraseWith(self(), first, last);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename Pred>
+size_t AVLTree<Key, Value, Compare, Derived>::erase_if(Pred pred)
+{
+    return BinarySearchTree<Key, Value, Compare>::eraseIfWith(self(), pred);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::clear()
+{
+    BinarySearchTree<Key, Value, Compare>::clearWith(self());
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename ForwardIt>
+void AVLTree<Key, Value, Compare, Derived>::assign(ForwardIt first, ForwardIt last)
+{
+    BinarySearchTree<Key, Value, Compare>::assignWith(self(), first, last);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+template<typename InputIt>
+void AVLTree<Key, Value, Compare, Derived>::assignUnsorted(InputIt first, InputIt last)
+{
+    std::vector<std::pair<Key, Value> > items = BinarySearchTree<Key, Value, Compare>::sortedUnique(first, last, this->comp_);
+    assign(items.begin(), items.end());
+}
+
+template<class Key, class Value, class Compare, class Derived>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Derived>::insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* new_node)
+{
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare>::linkLeaf(self(), parent, new_node));
+    if(parent != nullptr){
+        insertFix(static_cast<AVLNode<Key, Value>*>(parent), curr);
     }
     return curr;
 }
 
-template<class Key, class Value>
-int AVLTree<Key, Value>::maxHeight(AVLNode<Key, Value>* curr){
-    if(curr == nullptr){
-        return 0;
-    }
-    int left = maxHeight(curr->getLeft());
-    int right = maxHeight(curr->getRight());
-    if(left > right){
-        return ++left;
-    }
-    return ++right;
+template<class Key, class Value, class Compare, class Derived>
+template<typename... Args>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Derived>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (this->template allocateNode<AVLNode<Key, Value> >()) AVLNode<Key, Value>(static_cast<AVLNode<Key, Value>*>(parent), std::forward<Args>(args)...);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* prev){
-    if(prev == nullptr){
-        return;
-    }
-    AVLNode<Key, Value>* curr = prev;
-    AVLNode<Key, Value>* next = prev;
-    if((prev->getBalance()) < -1){
-        if(((prev->getLeft())->getBalance()) < 0){
-            curr = (prev->getLeft());
-            insertLeft(prev);
+/**
+* A copy of src under parent, keeping its balance.
+*/
+template<class Key, class Value, class Compare, class Derived>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Derived>::cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent)
+{
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(self().createNode(parent, src->getItem()));
+    curr->setBalance(static_cast<AVLNode<Key, Value>*>(src)->getBalance());
+    return curr;
+}
+
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::destroyNode(Node<Key, Value>* curr)
+{
+    this->freeNode(static_cast<AVLNode<Key, Value>*>(curr));
+}
+
+/**
+* A bulk-built node's balance follows directly from its subtree heights.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::buildFix(Node<Key, Value>* curr, int leftHeight, int rightHeight)
+{
+    static_cast<AVLNode<Key, Value>*>(curr)->setBalance(rightHeight - leftHeight);
+}
+
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::internalFindAVL(const Key& key) const{
+    return static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+}
+
+/**
+ * Retraces from the newly attached node curr up through its parent prev,
+ * using only the stored balances. Stops as soon as a subtree's height is
+ * unchanged: either an ancestor became even, or one (single or double)
+ * rotation restored the height the subtree had before the insert.
+ */
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::insertFix(AVLNode<Key, Value>* prev, AVLNode<Key, Value>* curr){
+    while(prev != nullptr){
+        if((prev->getLeft()) == curr){
+            prev->updateBalance(-1);
         }
         else{
-            next = (prev->getLeft());
-            insertRight(prev->getLeft());
-            curr = (prev->getLeft());
+            prev->updateBalance(1);
+        }
+        if((prev->getBalance()) == 0){
+            return;
+        }
+        if(((prev->getBalance()) < -1) || ((prev->getBalance()) > 1)){
+            rebalance(prev);
+            return;
+        }
+        curr = prev;
+        prev = (prev->getParent());
+    }
+}
+
+/**
+ * Rotates the subtree rooted at prev, whose balance is -2 or 2, back into
+ * AVL shape and fixes the balances of the rotated nodes from their old
+ * balances alone. Returns the new root of the subtree.
+ */
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::rebalance(AVLNode<Key, Value>* prev){
+    if((prev->getBalance()) < 0){
+        AVLNode<Key, Value>* curr = (prev->getLeft());
+        if((curr->getBalance()) <= 0){
             insertLeft(prev);
+            if((curr->getBalance()) == 0){
+                prev->setBalance(-1);
+                curr->setBalance(1);
+            }
+            else{
+                prev->setBalance(0);
+                curr->setBalance(0);
+            }
+            return curr;
         }
+        AVLNode<Key, Value>* next = (curr->getRight());
+        insertRight(curr);
+        insertLeft(prev);
+        curr->setBalance(((next->getBalance()) > 0) ? -1 : 0);
+        prev->setBalance(((next->getBalance()) < 0) ? 1 : 0);
+        next->setBalance(0);
+        return next;
     }
-    else if((prev->getBalance()) > 1){
-        if(((prev->getRight())->getBalance()) > 0){
-            curr = (prev->getRight());
-            insertRight(prev);
+    AVLNode<Key, Value>* curr = (prev->getRight());
+    if((curr->getBalance()) >= 0){
+        insertRight(prev);
+        if((curr->getBalance()) == 0){
+            prev->setBalance(1);
+            curr->setBalance(-1);
         }
         else{
-            next = (prev->getRight());
-            insertLeft(prev->getRight());
-            curr = (prev->getRight());
-            insertRight(prev);
+            prev->setBalance(0);
+            curr->setBalance(0);
         }
+        return curr;
     }
-    prev->setBalance(maxHeight(prev->getRight()) - maxHeight(prev->getLeft()));
-    curr->setBalance(maxHeight(curr->getRight()) - maxHeight(curr->getLeft()));
-    next->setBalance(maxHeight(next->getRight()) - maxHeight(next->getLeft()));
+    AVLNode<Key, Value>* next = (curr->getLeft());
+    insertLeft(curr);
+    insertRight(prev);
+    curr->setBalance(((next->getBalance()) < 0) ? 1 : 0);
+    prev->setBalance(((next->getBalance()) > 0) ? -1 : 0);
+    next->setBalance(0);
+    return next;
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertLeft(AVLNode<Key, Value>* pare){
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::insertLeft(AVLNode<Key, Value>* pare){
     if(pare == nullptr){
         return;
     }
@@ -274,30 +633,34 @@ void AVLTree<Key, Value>::insertLeft(AVLNode<Key, Value>* pare){
     }
     AVLNode<Key, Value>* temp = (prev->getRight());
     if((pare->getParent()) == nullptr){
-        this->root_ = prev;
+        if((this->root_) == pare){
+            self().setRoot(prev);
+        }
         prev->setParent(nullptr);
     }
     else if(((pare->getParent())->getLeft()) == pare){
-        (pare->getParent())->setLeft(prev);
+        self().publishLeft(pare->getParent(), prev);
         prev->setParent(pare->getParent());
     }
     else if(((pare->getParent())->getRight()) == pare){
-        (pare->getParent())->setRight(prev);
+        self().publishRight(pare->getParent(), prev);
         prev->setParent(pare->getParent());
     }
-    prev->setRight(pare);
+    self().publishRight(prev, pare);
     if(temp != nullptr){
         temp->setParent(pare);
-        pare->setLeft(temp);
+        self().publishLeft(pare, temp);
     }
     else{
-        pare->setLeft(nullptr);
+        self().publishLeft(pare, nullptr);
     }
     pare->setParent(prev);
+    self().updateNode(pare);
+    self().updateNode(prev);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertRight(AVLNode<Key, Value>* pare){
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::insertRight(AVLNode<Key, Value>* pare){
     if(pare == nullptr){
         return;
     }
@@ -307,95 +670,95 @@ void AVLTree<Key, Value>::insertRight(AVLNode<Key, Value>* pare){
     }
     AVLNode<Key, Value>* temp = (prev->getLeft());
     if((pare->getParent()) == nullptr){
-        this->root_ = prev;
+        if((this->root_) == pare){
+            self().setRoot(prev);
+        }
         prev->setParent(nullptr);
     }
     else if(((pare->getParent())->getLeft()) == pare){
-        (pare->getParent())->setLeft(prev);
+        self().publishLeft(pare->getParent(), prev);
         prev->setParent(pare->getParent());
     }
     else if(((pare->getParent())->getRight()) == pare){
-        (pare->getParent())->setRight(prev);
+        self().publishRight(pare->getParent(), prev);
         prev->setParent(pare->getParent());
     }
-    prev->setLeft(pare);
+    self().publishLeft(prev, pare);
     if(temp != nullptr){
         temp->setParent(pare);
-        pare->setRight(temp);
+        self().publishRight(pare, temp);
     }
     else{
-        pare->setRight(nullptr);
+        self().publishRight(pare, nullptr);
     }
     pare->setParent(prev);
+    self().updateNode(pare);
+    self().updateNode(prev);
 }
 
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>:: remove(const Key& key)
 {
     // TODO
-    AVLNode<Key, Value>* curr = internalFindAVL(key);
+    self().removeNode(internalFindAVL(key));
+}
+
+/**
+* Removes the item whose key is equivalent to key without converting key
+* to a Key; see BinarySearchTree::find.
+*/
+template<class Key, class Value, class Compare, class Derived>
+template<typename K, typename C, typename>
+void AVLTree<Key, Value, Compare, Derived>::remove(const K& key)
+{
+    self().removeNode(this->internalFind(key));
+}
+
+/**
+* Unlinks and frees node, which may be NULL, and rebalances above it.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::removeNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(node);
     if(curr == nullptr){
         return;
     }
-    AVLNode<Key, Value>* next = curr;
+    this->unlinkEnds(curr);
     if(((curr->getLeft()) != nullptr) && ((curr->getRight()) != nullptr)){
-        next = predecessor(curr);
-        nodeSwap(curr, next);
-        next->setBalance(maxHeight(next->getRight()) - maxHeight(next->getLeft()));
-        curr->setBalance(maxHeight(curr->getRight()) - maxHeight(curr->getLeft()));
-        return remove(key);
-    }
-    if(((curr->getLeft()) == nullptr) && ((curr->getRight()) == nullptr)){
-        next = (curr->getParent());
-        if(next == nullptr){
-            (this->root_) = nullptr;
-            delete curr;
-            return;
-        }
-        else if((next->getRight()) == curr){
-            next->setRight(nullptr);
-        }
-        else{
-             next->setLeft(nullptr);
-        }
-        delete curr;
-        curr = next;
-        while(curr != nullptr){
-            curr->setBalance(maxHeight(curr->getRight()) - maxHeight(curr->getLeft()));
-            if(((curr->getBalance()) < -1) || ((curr->getBalance()) > 1)){
-                insertFix(curr);
-            }
-            curr = (curr->getParent());
-        }
-        return;
+        self().nodeSwap(curr, predecessor(curr));
     }
-    if((curr->getLeft()) != nullptr){
-        next = curr->getLeft();
-        nodeSwap(next, curr);
-        next->setLeft(nullptr);
+    AVLNode<Key, Value>* child = (curr->getLeft());
+    if(child == nullptr){
+        child = (curr->getRight());
     }
-    else if((curr->getRight()) != nullptr){
-        next = curr->getRight();
-        nodeSwap(next, curr);
-        next->setRight(nullptr);
+    AVLNode<Key, Value>* prev = (curr->getParent());
+    int8_t diff = 0;
+    if(prev == nullptr){
+        self().setRoot(child);
     }
-    delete curr;
-    curr = next;
-    while(curr != nullptr){
-        curr->setBalance(maxHeight(curr->getRight()) - maxHeight(curr->getLeft()));
-        if(((curr->getBalance()) < -1) || ((curr->getBalance()) > 1)){
-            insertFix(curr);
-        }
-        curr = (curr->getParent());
+    else if((prev->getLeft()) == curr){
+        self().publishLeft(prev, child);
+        diff = 1;
     }
+    else{
+        self().publishRight(prev, child);
+        diff = -1;
+    }
+    if(child != nullptr){
+        child->setParent(prev);
+    }
+    self().destroyNode(curr);
+    self().updatePath(prev);
+    removeFix(prev, diff);
 }
 
-template<class Key, class Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* current)
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::predecessor(AVLNode<Key, Value>* current)
 {
     // TODO
     if(current == nullptr){
@@ -404,7 +767,7 @@ AVLNode<Key, Value>* AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* curre
     AVLNode<Key, Value>* curr = (current->getLeft());
     AVLNode<Key, Value>* prev = (current->getParent());
     if(curr == nullptr){
-        curr = prev;
+        curr = current;
         while(prev != nullptr){
             if(curr == (prev->getRight())){
                 return prev;
@@ -422,14 +785,578 @@ AVLNode<Key, Value>* AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* curre
     return prev;
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* curr){
+/**
+ * Retraces after a node was unlinked below curr, whose balance changes by
+ * diff (+1 if its left subtree shrank, -1 if its right one did). Keeps
+ * climbing only while the subtree it just fixed got shorter; stops once a
+ * node goes from even to leaning, or a rotation around an even child
+ * leaves the height unchanged.
+ */
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::removeFix(AVLNode<Key, Value>* curr, int8_t diff){
+    while(curr != nullptr){
+        AVLNode<Key, Value>* prev = (curr->getParent());
+        int8_t nextDiff = 0;
+        if(prev != nullptr){
+            nextDiff = ((prev->getLeft()) == curr) ? 1 : -1;
+        }
+        curr->updateBalance(diff);
+        if(((curr->getBalance()) == -1) || ((curr->getBalance()) == 1)){
+            return;
+        }
+        if((curr->getBalance()) != 0){
+            AVLNode<Key, Value>* heavy = ((curr->getBalance()) < 0) ? (curr->getLeft()) : (curr->getRight());
+            bool evenChild = ((heavy->getBalance()) == 0);
+            rebalance(curr);
+            if(evenChild){
+                return;
+            }
+        }
+        curr = prev;
+        diff = nextDiff;
+    }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+/*
+  -----------------------------------------------
+  Begin join-based operations.
+
+  Everything below is built from join: hang two trees whose heights may
+  differ off a pivot node, walking down the spine of the taller one and
+  retracing from there like an insert. split, union, intersection and
+  difference then each cost O(m log(n/m + 1)) for trees of sizes m <= n.
+  -----------------------------------------------
+*/
+
+/**
+* Splits the tree around key: left receives every item with a smaller key
+* and right every item with a key that is not smaller. This tree ends up
+* empty; the previous contents of left and right are cleared.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::split(const Key& key, Self& left, Self& right)
+{
+    int height;
+    AVLNode<Key, Value>* curr = takeRoot(self(), height);
+    NodePool keep;
+    keep.adopt(this->pool_);
+    left.clear();
+    right.clear();
+    left.pool_.adopt(keep);
+    right.pool_.adopt(keep);
+    AVLNode<Key, Value>* lower;
+    AVLNode<Key, Value>* mid;
+    AVLNode<Key, Value>* upper;
+    int lowerHeight, upperHeight;
+    splitNodes(curr, height, key, lower, lowerHeight, mid, upper, upperHeight);
+    if(mid != nullptr){
+        upper = joinNodes(nullptr, 0, mid, upper, upperHeight, upperHeight);
+    }
+    this->root_ = nullptr;
+    left.root_ = lower;
+    right.root_ = upper;
+    left.resetEnds();
+    right.resetEnds();
+}
+
+/**
+* Replaces this tree with left, pivot and right joined together.
+* Every key in left must be smaller than the pivot's key, which must be
+* smaller than every key in right; otherwise std::invalid_argument is
+* thrown and nothing changes.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::join(Self& left, const std::pair<const Key, Value>& pivot, Self& right)
+{
+    Node<Key, Value>* last = left.getLargestNode();
+    Node<Key, Value>* first = right.getSmallestNode();
+    if(((last != nullptr) && !this->comp_(last->getKey(), pivot.first)) ||
+       ((first != nullptr) && !this->comp_(pivot.first, first->getKey()))){
+        throw std::invalid_argument("join: keys are not ordered");
+    }
+    int leftHeight, rightHeight, height;
+    AVLNode<Key, Value>* lower = takeRoot(left, leftHeight);
+    AVLNode<Key, Value>* upper = takeRoot(right, rightHeight);
+    NodePool keep;
+    keep.adopt(left.pool_);
+    keep.adopt(right.pool_);
+    this->clear();
+    this->pool_.adopt(keep);
+    AVLNode<Key, Value>* mid = static_cast<AVLNode<Key, Value>*>(self().createNode(nullptr, pivot));
+    AVLNode<Key, Value>* result = joinNodes(lower, leftHeight, mid, upper, rightHeight, height);
+    this->root_ = result;
+    this->resetEnds();
+}
+
+/**
+* Same as above without a pivot: every key in left must be smaller than
+* every key in right.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::join(Self& left, Self& right)
+{
+    Node<Key, Value>* last = left.getLargestNode();
+    Node<Key, Value>* first = right.getSmallestNode();
+    if((last != nullptr) && (first != nullptr) && !this->comp_(last->getKey(), first->getKey())){
+        throw std::invalid_argument("join: keys are not ordered");
+    }
+    int leftHeight, rightHeight, height;
+    AVLNode<Key, Value>* lower = takeRoot(left, leftHeight);
+    AVLNode<Key, Value>* upper = takeRoot(right, rightHeight);
+    NodePool keep;
+    keep.adopt(left.pool_);
+    keep.adopt(right.pool_);
+    this->clear();
+    this->pool_.adopt(keep);
+    AVLNode<Key, Value>* result = joinNodes(lower, leftHeight, upper, rightHeight, height);
+    this->root_ = result;
+    this->resetEnds();
+}
+
+/**
+* Adds every item of other to this tree; for keys in both trees the value
+* from other wins, as if its items had been inserted. other ends up empty.
+* With threads > 1, independent halves are merged concurrently.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::unionWith(Self& other, unsigned int threads)
+{
+    if(&other == this){
+        return;
+    }
+    int h1, h2, height;
+    AVLNode<Key, Value>* t1 = takeRoot(self(), h1);
+    AVLNode<Key, Value>* t2 = takeRoot(other, h2);
+    this->pool_.adopt(other.pool_);
+    AVLNode<Key, Value>* result = unionNodes(t1, h1, t2, h2, height, threads);
+    this->root_ = result;
+    this->resetEnds();
+}
+
+/**
+* Keeps only the items whose keys are also in other, with the values from
+* this tree. other ends up empty.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::intersectWith(Self& other, unsigned int threads)
+{
+    if(&other == this){
+        return;
+    }
+    int h1, h2, height;
+    AVLNode<Key, Value>* t1 = takeRoot(self(), h1);
+    AVLNode<Key, Value>* t2 = takeRoot(other, h2);
+    this->pool_.adopt(other.pool_);
+    AVLNode<Key, Value>* result = intersectNodes(t1, h1, t2, h2, height, threads);
+    this->root_ = result;
+    this->resetEnds();
+}
+
+/**
+* Removes every key that is also in other. other ends up empty.
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::differenceWith(Self& other, unsigned int threads)
+{
+    int h1, h2, height;
+    if(&other == this){
+        this->clear();
+        return;
+    }
+    AVLNode<Key, Value>* t1 = takeRoot(self(), h1);
+    AVLNode<Key, Value>* t2 = takeRoot(other, h2);
+    this->pool_.adopt(other.pool_);
+    AVLNode<Key, Value>* result = differenceNodes(t1, h1, t2, h2, height, threads);
+    this->root_ = result;
+    this->resetEnds();
+}
+
+/**
+* Empties tree and hands back its root along with its height.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::takeRoot(Self& tree, int& height)
+{
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(tree.root_);
+    tree.root_ = nullptr;
+    tree.leftmost_ = nullptr;
+    tree.rightmost_ = nullptr;
+    height = treeHeight(curr);
+    return curr;
+}
+
+/**
+* The height of a subtree in O(log n): always step into the taller child.
+*/
+template<class Key, class Value, class Compare, class Derived>
+int AVLTree<Key, Value, Compare, Derived>::treeHeight(AVLNode<Key, Value>* curr) const
+{
+    int height = 0;
+    while(curr != nullptr){
+        height++;
+        curr = ((curr->getBalance()) < 0) ? (curr->getLeft()) : (curr->getRight());
+    }
+    return height;
+}
+
+/**
+* Retraces after the subtree at curr grew by one, like insertFix, except
+* that a rotation around an even child (possible after a join) leaves the
+* subtree taller and so keeps going. Returns 1 if the whole tree grew.
+*/
+template<class Key, class Value, class Compare, class Derived>
+int AVLTree<Key, Value, Compare, Derived>::joinFix(AVLNode<Key, Value>* prev, AVLNode<Key, Value>* curr)
+{
+    while(prev != nullptr){
+        if((prev->getLeft()) == curr){
+            prev->updateBalance(-1);
+        }
+        else{
+            prev->updateBalance(1);
+        }
+        if((prev->getBalance()) == 0){
+            return 0;
+        }
+        curr = prev;
+        if(((prev->getBalance()) < -1) || ((prev->getBalance()) > 1)){
+            AVLNode<Key, Value>* heavy = ((prev->getBalance()) < 0) ? (prev->getLeft()) : (prev->getRight());
+            bool evenChild = ((heavy->getBalance()) == 0);
+            curr = rebalance(prev);
+            if(!evenChild){
+                return 0;
+            }
+        }
+        prev = (curr->getParent());
+    }
+    return 1;
+}
+
+/**
+* Joins left, pivot and right (all keys in that order) into one subtree
+* and returns it, setting height. Costs O(|leftHeight - rightHeight| + 1).
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::joinNodes(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+                                                    AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    pivot->setParent(nullptr);
+    if((leftHeight <= rightHeight + 1) && (rightHeight <= leftHeight + 1)){
+        pivot->setLeft(left);
+        pivot->setRight(right);
+        if(left != nullptr){
+            left->setParent(pivot);
+        }
+        if(right != nullptr){
+            right->setParent(pivot);
+        }
+        pivot->setBalance(rightHeight - leftHeight);
+        self().updateNode(pivot);
+        height = std::max(leftHeight, rightHeight) + 1;
+        return pivot;
+    }
+    AVLNode<Key, Value>* prev = nullptr;
+    AVLNode<Key, Value>* top;
+    if(leftHeight > rightHeight){
+        // walk down the right spine of left to a subtree as tall as right
+        AVLNode<Key, Value>* curr = left;
+        int currHeight = leftHeight;
+        while(currHeight > rightHeight + 1){
+            currHeight -= ((curr->getBalance()) < 0) ? 2 : 1;
+            prev = curr;
+            curr = (curr->getRight());
+        }
+        pivot->setLeft(curr);
+        pivot->setRight(right);
+        pivot->setBalance(rightHeight - currHeight);
+        if(curr != nullptr){
+            curr->setParent(pivot);
+        }
+        if(right != nullptr){
+            right->setParent(pivot);
+        }
+        prev->setRight(pivot);
+        pivot->setParent(prev);
+        self().updatePath(pivot);
+        top = left;
+        height = leftHeight + joinFix(prev, pivot);
+    }
+    else{
+        AVLNode<Key, Value>* curr = right;
+        int currHeight = rightHeight;
+        while(currHeight > leftHeight + 1){
+            currHeight -= ((curr->getBalance()) > 0) ? 2 : 1;
+            prev = curr;
+            curr = (curr->getLeft());
+        }
+        pivot->setLeft(left);
+        pivot->setRight(curr);
+        pivot->setBalance(currHeight - leftHeight);
+        if(curr != nullptr){
+            curr->setParent(pivot);
+        }
+        if(left != nullptr){
+            left->setParent(pivot);
+        }
+        prev->setLeft(pivot);
+        pivot->setParent(prev);
+        self().updatePath(pivot);
+        top = right;
+        height = rightHeight + joinFix(prev, pivot);
+    }
+    // at most one rotation happens at the top, and it moves the old top
+    // under the new one
+    if((top->getParent()) != nullptr){
+        top = (top->getParent());
+    }
+    return top;
+}
+
+/**
+* Joins two subtrees without a pivot by borrowing the largest node of left.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::joinNodes(AVLNode<Key, Value>* left, int leftHeight,
+                                                    AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    if(left == nullptr){
+        height = rightHeight;
+        return right;
+    }
+    AVLNode<Key, Value>* last;
+    left = splitLast(left, leftHeight, last, leftHeight);
+    return joinNodes(left, leftHeight, last, right, rightHeight, height);
+}
+
+/**
+* Detaches both children of curr and reports their heights, which follow
+* from curr's height and balance. Returns curr, now a lone node.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::detachChildren(AVLNode<Key, Value>* curr, int height,
+                                                         AVLNode<Key, Value>*& left, int& leftHeight,
+                                                         AVLNode<Key, Value>*& right, int& rightHeight)
+{
+    leftHeight = height - (((curr->getBalance()) > 0) ? 2 : 1);
+    rightHeight = height - (((curr->getBalance()) < 0) ? 2 : 1);
+    left = (curr->getLeft());
+    right = (curr->getRight());
+    if(left != nullptr){
+        left->setParent(nullptr);
+    }
+    if(right != nullptr){
+        right->setParent(nullptr);
+    }
+    curr->setLeft(nullptr);
+    curr->setRight(nullptr);
+    curr->setParent(nullptr);
+    curr->setBalance(0);
+    self().updateNode(curr);
+    return curr;
+}
+
+/**
+* Splits the subtree at curr into keys below key (left), the node holding
+* key if there is one (mid), and keys above it (right).
+*/
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::splitNodes(AVLNode<Key, Value>* curr, int height, const Key& key,
+                                     AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& mid,
+                                     AVLNode<Key, Value>*& right, int& rightHeight)
+{
+    if(curr == nullptr){
+        left = mid = right = nullptr;
+        leftHeight = rightHeight = 0;
+        return;
+    }
+    AVLNode<Key, Value>* lower;
+    AVLNode<Key, Value>* upper;
+    int lowerHeight, upperHeight;
+    detachChildren(curr, height, lower, lowerHeight, upper, upperHeight);
+    if(this->comp_(key, curr->getKey())){
+        AVLNode<Key, Value>* rest;
+        int restHeight;
+        splitNodes(lower, lowerHeight, key, left, leftHeight, mid, rest, restHeight);
+        right = joinNodes(rest, restHeight, curr, upper, upperHeight, rightHeight);
+    }
+    else if(this->comp_(curr->getKey(), key)){
+        AVLNode<Key, Value>* rest;
+        int restHeight;
+        splitNodes(upper, upperHeight, key, rest, restHeight, mid, right, rightHeight);
+        left = joinNodes(lower, lowerHeight, curr, rest, restHeight, leftHeight);
+    }
+    else{
+        left = lower;
+        leftHeight = lowerHeight;
+        right = upper;
+        rightHeight = upperHeight;
+        mid = curr;
+    }
+}
+
+/**
+* Unlinks the largest node of the subtree at curr into last and returns
+* what remains, setting restHeight.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::splitLast(AVLNode<Key, Value>* curr, int height, AVLNode<Key, Value>*& last, int& restHeight)
+{
+    AVLNode<Key, Value>* lower;
+    AVLNode<Key, Value>* upper;
+    int lowerHeight, upperHeight;
+    detachChildren(curr, height, lower, lowerHeight, upper, upperHeight);
+    if(upper == nullptr){
+        last = curr;
+        restHeight = lowerHeight;
+        return lower;
+    }
+    upper = splitLast(upper, upperHeight, last, upperHeight);
+    return joinNodes(lower, lowerHeight, curr, upper, upperHeight, restHeight);
+}
+
+/**
+* Union of two detached subtrees: split t2 around the root of t1, merge
+* the matching halves (concurrently while thread budget remains and the
+* subtrees are large enough to pay for a thread), then join them back
+* around the root. On equal keys the node from t2 is kept.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::unionNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                                     int& height, unsigned int threads)
+{
+    if(t1 == nullptr){
+        height = h2;
+        return t2;
+    }
+    if(t2 == nullptr){
+        height = h1;
+        return t1;
+    }
+    AVLNode<Key, Value>* l1;
+    AVLNode<Key, Value>* r1;
+    AVLNode<Key, Value>* l2;
+    AVLNode<Key, Value>* r2;
+    AVLNode<Key, Value>* mid;
+    int l1Height, r1Height, l2Height, r2Height;
+    detachChildren(t1, h1, l1, l1Height, r1, r1Height);
+    splitNodes(t2, h2, t1->getKey(), l2, l2Height, mid, r2, r2Height);
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    if((threads > 1) && (h1 + h2 > 24)){
+        std::future<AVLNode<Key, Value>*> pending = std::async(std::launch::async,
+            [&]() -> AVLNode<Key, Value>* {
+                return this->unionNodes(l1, l1Height, l2, l2Height, leftHeight, threads / 2);
+            });
+        right = unionNodes(r1, r1Height, r2, r2Height, rightHeight, threads - threads / 2);
+        left = pending.get();
+    }
+    else{
+        left = unionNodes(l1, l1Height, l2, l2Height, leftHeight, 1);
+        right = unionNodes(r1, r1Height, r2, r2Height, rightHeight, 1);
+    }
+    if(mid != nullptr){
+        self().destroyNode(t1);
+        t1 = mid;
+    }
+    return joinNodes(left, leftHeight, t1, right, rightHeight, height);
+}
+
+/**
+* Intersection of two detached subtrees, keeping the nodes of t1.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::intersectNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                                         int& height, unsigned int threads)
+{
+    if((t1 == nullptr) || (t2 == nullptr)){
+        BinarySearchTree<Key, Value, Compare>::clearHelper(self(), t1);
+        BinarySearchTree<Key, Value, Compare>::clearHelper(self(), t2);
+        height = 0;
+        return nullptr;
+    }
+    AVLNode<Key, Value>* l1;
+    AVLNode<Key, Value>* r1;
+    AVLNode<Key, Value>* l2;
+    AVLNode<Key, Value>* r2;
+    AVLNode<Key, Value>* mid;
+    int l1Height, r1Height, l2Height, r2Height;
+    detachChildren(t1, h1, l1, l1Height, r1, r1Height);
+    splitNodes(t2, h2, t1->getKey(), l2, l2Height, mid, r2, r2Height);
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    if((threads > 1) && (h1 + h2 > 24)){
+        std::future<AVLNode<Key, Value>*> pending = std::async(std::launch::async,
+            [&]() -> AVLNode<Key, Value>* {
+                return this->intersectNodes(l1, l1Height, l2, l2Height, leftHeight, threads / 2);
+            });
+        right = intersectNodes(r1, r1Height, r2, r2Height, rightHeight, threads - threads / 2);
+        left = pending.get();
+    }
+    else{
+        left = intersectNodes(l1, l1Height, l2, l2Height, leftHeight, 1);
+        right = intersectNodes(r1, r1Height, r2, r2Height, rightHeight, 1);
+    }
+    if(mid != nullptr){
+        self().destroyNode(mid);
+        return joinNodes(left, leftHeight, t1, right, rightHeight, height);
+    }
+    self().destroyNode(t1);
+    return joinNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/**
+* Difference of two detached subtrees: the keys of t1 that are not in t2.
+*/
+template<class Key, class Value, class Compare, class Derived>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Derived>::differenceNodes(AVLNode<Key, Value>* t1, int h1, AVLNode<Key, Value>* t2, int h2,
+                                                          int& height, unsigned int threads)
+{
+    if((t1 == nullptr) || (t2 == nullptr)){
+        BinarySearchTree<Key, Value, Compare>::clearHelper(self(), t2);
+        height = (t1 == nullptr) ? 0 : h1;
+        return t1;
+    }
+    AVLNode<Key, Value>* l1;
+    AVLNode<Key, Value>* r1;
+    AVLNode<Key, Value>* l2;
+    AVLNode<Key, Value>* r2;
+    AVLNode<Key, Value>* mid;
+    int l1Height, r1Height, l2Height, r2Height;
+    detachChildren(t2, h2, l2, l2Height, r2, r2Height);
+    splitNodes(t1, h1, t2->getKey(), l1, l1Height, mid, r1, r1Height);
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    if((threads > 1) && (h1 + h2 > 24)){
+        std::future<AVLNode<Key, Value>*> pending = std::async(std::launch::async,
+            [&]() -> AVLNode<Key, Value>* {
+                return this->differenceNodes(l1, l1Height, l2, l2Height, leftHeight, threads / 2);
+            });
+        right = differenceNodes(r1, r1Height, r2, r2Height, rightHeight, threads - threads / 2);
+        left = pending.get();
+    }
+    else{
+        left = differenceNodes(l1, l1Height, l2, l2Height, leftHeight, 1);
+        right = differenceNodes(r1, r1Height, r2, r2Height, rightHeight, 1);
+    }
+    self().destroyNode(t2);
+    if(mid != nullptr){
+        self().destroyNode(mid);
+    }
+    return joinNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/*
+  -----------------------------------------------
+  End join-based operations.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Derived>
+void AVLTree<Key, Value, Compare, Derived>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare>::nodeSwapWith(self(), n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
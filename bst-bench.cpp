@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+#include "concurrentavlbst.h"
+#include "compactavlbst.h"
+#include "stackavlbst.h"
+#include "threadedavlbst.h"
+#include "persistentavlbst.h"
+#include "btree.h"
+
+using namespace std;
+
+/*
+ * Micro benchmarks for the search trees. Build with `make bench`; the
+ * bst-bench-heap binary is the same code built with -DBST_HEAP_NODES,
+ * i.e. with every node allocated and freed on its own.
+ */
+
+/*
+ * std::map under the tree interface the benchmarks use, as a baseline.
+ */
+struct StdMap : public map<int, int>
+{
+    void remove(int key){ erase(key); }
+};
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* name, size_t n, double seconds)
+{
+    printf("%-28s n=%-8zu %8.3f ms  %8.1f ns/op\n", name, n, seconds * 1e3, seconds * 1e9 / n);
+}
+
+/*
+ * Insert throughput and teardown time for keys in the given order.
+ * Teardown is the time taken by the destructor.
+ */
+template<typename Tree>
+static void benchInsertTeardown(const char* name, const vector<int>& keys)
+{
+    Tree* tree = new Tree();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); i++){
+        tree->insert(make_pair(keys[i], (int)i));
+    }
+    report((string(name) + " insert").c_str(), keys.size(), secondsSince(start));
+
+    start = chrono::steady_clock::now();
+    delete tree;
+    report((string(name) + " teardown").c_str(), keys.size(), secondsSince(start));
+}
+
+/*
+ * Churn: remove and re-insert keys so that freed nodes get reused.
+ */
+template<typename Tree>
+static void benchChurn(const vector<int>& keys)
+{
+    Tree tree;
+    for(size_t i = 0; i < keys.size(); i++){
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); i++){
+        tree.remove(keys[i]);
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    report("random remove+insert", keys.size(), secondsSince(start));
+}
+
+/*
+ * Lookups of every key, in the order given, in a tree built from them.
+ */
+template<typename Tree>
+static void benchFind(const vector<int>& keys)
+{
+    Tree tree;
+    for(size_t i = 0; i < keys.size(); i++){
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    long sum = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); i++){
+        sum += tree.find(keys[i])->second;
+    }
+    report("random find", keys.size(), secondsSince(start));
+    if(sum == 42){
+        printf("\n");
+    }
+}
+
+template<typename Tree>
+static void benchAll(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; i++){
+        keys[i] = (int)i;
+    }
+    benchInsertTeardown<Tree>("sequential", keys);
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+    benchInsertTeardown<Tree>("random", keys);
+    benchChurn<Tree>(keys);
+    benchFind<Tree>(keys);
+}
+
+/*
+ * Lookups in a tree built once, against its frozen snapshots: the
+ * Eytzinger one, and the block one with each kernel the CPU has. Keys
+ * are every other integer, and half the lookups miss.
+ */
+static void benchFrozen(size_t n)
+{
+    vector<pair<int, int> > items(n);
+    for(size_t i = 0; i < n; i++){
+        items[i] = make_pair(2 * (int)i, (int)i);
+    }
+    AVLTree<int, int> tree(items.begin(), items.end());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    FrozenTree<int, int> frozen = tree.freeze();
+    report("freeze", n, secondsSince(start));
+
+    vector<int> keys(n);
+    mt19937 rng(7);
+    for(size_t i = 0; i < n; i++){
+        keys[i] = (int)(rng() % (2 * n));
+    }
+    long found = 0;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; i++){
+        found += (tree.find(keys[i]) != tree.end());
+    }
+    const long hits = found;
+    double treeSeconds = secondsSince(start);
+    report("AVLTree find", n, treeSeconds);
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; i++){
+        found -= (frozen.find(keys[i]) != frozen.end());
+    }
+    double frozenSeconds = secondsSince(start);
+    report("FrozenTree find", n, frozenSeconds);
+    printf("frozen speedup %.2fx%s\n", treeSeconds / frozenSeconds, (found == 0) ? "" : " (results differ!)");
+
+    FrozenBTree<int, int> blocks = tree.freezeBlocks();
+    const char* names[] = {"FrozenBTree find (scalar)", "FrozenBTree find (SSE4.2)", "FrozenBTree find (AVX2)"};
+    double scalarSeconds = 0;
+    for(int kernel = SCALAR_KERNEL; kernel <= bestSearchKernel(); kernel++){
+        blocks.useKernel(static_cast<SearchKernel>(kernel));
+        found = 0;
+        start = chrono::steady_clock::now();
+        for(size_t i = 0; i < n; i++){
+            found += (blocks.find(keys[i]) != blocks.end());
+        }
+        double seconds = secondsSince(start);
+        report(names[kernel], n, seconds);
+        if(kernel == SCALAR_KERNEL){
+            scalarSeconds = seconds;
+        }
+        else{
+            printf("SIMD speedup over scalar blocks %.2fx%s\n", scalarSeconds / seconds, (found == hits) ? "" : " (results differ!)");
+        }
+    }
+}
+
+/*
+ * Copying a tree of n random keys: re-inserting every item, against the
+ * structural clone, serial and with 4 threads.
+ */
+static void benchClone(size_t n)
+{
+    AVLTree<int, int> tree;
+    mt19937 rng(11);
+    for(size_t i = 0; i < n; i++){
+        tree.insert(make_pair((int)rng(), (int)i));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    AVLTree<int, int> reinserted;
+    for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it){
+        reinserted.insert(*it);
+    }
+    double insertSeconds = secondsSince(start);
+    report("copy by re-inserting", n, insertSeconds);
+    start = chrono::steady_clock::now();
+    AVLTree<int, int> cloned(tree);
+    double cloneSeconds = secondsSince(start);
+    report("clone", n, cloneSeconds);
+    start = chrono::steady_clock::now();
+    AVLTree<int, int> parallel = tree.clone(4);
+    double parallelSeconds = secondsSince(start);
+    report("clone (4 threads)", n, parallelSeconds);
+    printf("clone speedup %.2fx, with threads %.2fx\n", insertSeconds / cloneSeconds, insertSeconds / parallelSeconds);
+}
+
+/*
+ * Counting n random string keys, a quarter of them distinct: find then
+ * insert on a miss, against find_or_insert.
+ */
+static void benchUpsert(size_t n)
+{
+    vector<string> words;
+    mt19937 rng(13);
+    for(size_t i = 0; i < n; i++){
+        words.push_back("word" + to_string(rng() % (n / 4)));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    AVLTree<string, int> twice;
+    for(size_t i = 0; i < n; i++){
+        AVLTree<string, int>::iterator it = twice.find(words[i]);
+        if(it == twice.end()){
+            twice.insert(make_pair(words[i], 1));
+        }
+        else{
+            it->second++;
+        }
+    }
+    double twiceSeconds = secondsSince(start);
+    report("find then insert", n, twiceSeconds);
+    start = chrono::steady_clock::now();
+    AVLTree<string, int> once;
+    for(size_t i = 0; i < n; i++){
+        once.find_or_insert(words[i], 0).first++;
+    }
+    double onceSeconds = secondsSince(start);
+    report("find_or_insert", n, onceSeconds);
+    printf("find_or_insert speedup %.2fx\n", twiceSeconds / onceSeconds);
+}
+
+/*
+ * Dropping every other item of a tree of n random keys: remove by key
+ * while collecting the keys, against one erase_if sweep.
+ */
+static void benchSweep(size_t n)
+{
+    AVLTree<int, int> byKey;
+    mt19937 rng(17);
+    for(size_t i = 0; i < n; i++){
+        byKey.insert(make_pair((int)rng(), (int)i));
+    }
+    AVLTree<int, int> swept(byKey);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<int> expired;
+    for(AVLTree<int, int>::iterator it = byKey.begin(); it != byKey.end(); ++it){
+        if(it->second % 2 == 0){
+            expired.push_back(it->first);
+        }
+    }
+    for(size_t i = 0; i < expired.size(); i++){
+        byKey.remove(expired[i]);
+    }
+    double keySeconds = secondsSince(start);
+    report("sweep with remove(key)", n, keySeconds);
+    start = chrono::steady_clock::now();
+    swept.erase_if([](const pair<const int, int>& item){ return item.second % 2 == 0; });
+    double sweepSeconds = secondsSince(start);
+    report("sweep with erase_if", n, sweepSeconds);
+    printf("erase_if speedup %.2fx\n", keySeconds / sweepSeconds);
+}
+
+/*
+ * Full in-order scans, both ways, of a tree of n random keys: the plain
+ * AVLTree iterator, which climbs parent pointers, against the threads.
+ * The threads cost 16 bytes a node, so the sizes run from trees that sit
+ * in cache, where the threads pay off, to trees where every step waits
+ * on memory either way.
+ */
+template<typename Tree>
+static double scanTree(const char* name, const Tree& tree, size_t n, long& sum)
+{
+    // small trees get more passes, so every size times a few million steps
+    size_t passes = (n < 1000000) ? 5000000 / n : 5;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t pass = 0; pass < passes; pass++){
+        for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it){
+            sum += it->second;
+        }
+        for(typename Tree::reverse_iterator it = tree.rbegin(); it != tree.rend(); ++it){
+            sum -= it->second;
+        }
+    }
+    double seconds = secondsSince(start);
+    report(name, 2 * passes * n, seconds);
+    return seconds;
+}
+
+static void benchScan(size_t n)
+{
+    printf("scan of %zu keys (%zu byte nodes, %zu threaded)\n", n, sizeof(AVLNode<int, int>), sizeof(ThreadedAVLNode<int, int>));
+    AVLTree<int, int> plain;
+    ThreadedAVLTree<int, int> threaded;
+    mt19937 rng(19);
+    for(size_t i = 0; i < n; i++){
+        int key = (int)rng();
+        plain.insert(make_pair(key, (int)i));
+        threaded.insert(make_pair(key, (int)i));
+    }
+    long sum = 0;
+    double plainSeconds = scanTree("AVLTree scan", plain, n, sum);
+    double threadedSeconds = scanTree("ThreadedAVLTree scan", threaded, n, sum);
+    printf("threaded scan speedup %.2fx%s\n", plainSeconds / threadedSeconds, (sum == 0) ? "" : " (results differ!)");
+}
+
+/*
+ * An AVLTree behind a reader-writer lock, the usual way to share one.
+ * std::shared_mutex needs C++17, so this uses the pthread lock it wraps.
+ */
+struct LockedAVLTree
+{
+    LockedAVLTree(){ pthread_rwlock_init(&lock, nullptr); }
+    ~LockedAVLTree(){ pthread_rwlock_destroy(&lock); }
+    void insert(const pair<const int, int>& item)
+    {
+        pthread_rwlock_wrlock(&lock);
+        tree.insert(item);
+        pthread_rwlock_unlock(&lock);
+    }
+    bool get(int key, int& value)
+    {
+        pthread_rwlock_rdlock(&lock);
+        AVLTree<int, int>::iterator it = tree.find(key);
+        bool found = (it != tree.end());
+        if(found){
+            value = it->second;
+        }
+        pthread_rwlock_unlock(&lock);
+        return found;
+    }
+
+    AVLTree<int, int> tree;
+    pthread_rwlock_t lock;
+};
+
+/*
+ * Read-mostly use from several threads: each thread looks up random keys
+ * of a tree of n, and one lookup in 1000 is an insert instead. Reports
+ * the combined throughput of the threads.
+ */
+template<typename Tree>
+static double sharedThroughput(const char* name, Tree& tree, size_t n, unsigned int threads)
+{
+    const size_t opsPerThread = 1000000;
+    vector<thread> workers;
+    vector<long> found(threads, 0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned int t = 0; t < threads; t++){
+        workers.push_back(thread([&tree, &found, n, t, opsPerThread]{
+            mt19937 rng(100 + t);
+            int value;
+            for(size_t i = 0; i < opsPerThread; i++){
+                int key = (int)(rng() % (2 * n));
+                if(i % 1000 == 999){
+                    tree.insert(make_pair(key, (int)i));
+                }
+                else{
+                    found[t] += tree.get(key, value);
+                }
+            }
+        }));
+    }
+    for(unsigned int t = 0; t < threads; t++){
+        workers[t].join();
+    }
+    double seconds = secondsSince(start);
+    size_t ops = threads * opsPerThread;
+    printf("%-22s %2u threads %8.2f Mops/s\n", name, threads, ops / seconds / 1e6);
+    return ops / seconds;
+}
+
+static void benchShared(size_t n)
+{
+    printf("shared tree of %zu keys, %u hardware threads\n", n, thread::hardware_concurrency());
+    unsigned int counts[] = {1, 2, 4, 8, 16, 32};
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+        LockedAVLTree locked;
+        ConcurrentAVLTree<int, int> concurrent;
+        for(size_t i = 0; i < n; i++){
+            locked.insert(make_pair(2 * (int)i, (int)i));
+            concurrent.insert(make_pair(2 * (int)i, (int)i));
+        }
+        double lockedOps = sharedThroughput("rwlock AVLTree", locked, n, counts[c]);
+        double concurrentOps = sharedThroughput("ConcurrentAVLTree", concurrent, n, counts[c]);
+        printf("lock-free read speedup %.2fx\n", concurrentOps / lockedOps);
+    }
+}
+
+/*
+ * Point-in-time views of a tree of n random keys taken while it keeps
+ * changing. First the cost of one view: a structural copy of an
+ * AVLTree, against PersistentAVLTree::snapshot(). Then n random inserts
+ * and removes, with a snapshot every SNAPSHOT_EVERY writes of which the
+ * last KEPT stay alive, as readers would hold them; the nodes those
+ * snapshots keep beyond the tree's own are counted through sharedNodes.
+ */
+static void benchSnapshot(size_t n)
+{
+    const size_t SNAPSHOT_EVERY = 1000;
+    const size_t KEPT = 16;
+    AVLTree<int, int> plain;
+    PersistentAVLTree<int, int> persistent;
+    PersistentAVLTree<int, int> unshared;
+    mt19937 rng(23);
+    for(size_t i = 0; i < n; i++){
+        int key = (int)(rng() % (2 * n));
+        plain.insert(make_pair(key, (int)i));
+        persistent.insert(make_pair(key, (int)i));
+        unshared.insert(make_pair(key, (int)i));
+    }
+
+    const size_t copies = 10;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < copies; i++){
+        AVLTree<int, int> copy(plain);
+    }
+    double copySeconds = secondsSince(start) / copies;
+    printf("%-28s n=%-8zu %10.3f us per view\n", "AVLTree copy", n, copySeconds * 1e6);
+    const size_t snapshots = 1000000;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < snapshots; i++){
+        PersistentAVLTree<int, int> snapshot = persistent.snapshot();
+    }
+    double snapshotSeconds = secondsSince(start) / snapshots;
+    printf("%-28s n=%-8zu %10.3f us per view\n", "PersistentAVLTree snapshot", n, snapshotSeconds * 1e6);
+    printf("snapshot speedup %.0fx\n", copySeconds / snapshotSeconds);
+
+    vector<int> keys;
+    for(size_t i = 0; i < n; i++){
+        keys.push_back((int)(rng() % (2 * n)));
+    }
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; i++){
+        if(keys[i] % 2 == 0){
+            plain.insert(make_pair(keys[i], (int)i));
+        }
+        else{
+            plain.remove(keys[i] - 1);
+        }
+    }
+    report("AVLTree writes", n, secondsSince(start));
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; i++){
+        if(keys[i] % 2 == 0){
+            unshared.insert(make_pair(keys[i], (int)i));
+        }
+        else{
+            unshared.remove(keys[i] - 1);
+        }
+    }
+    report("persistent, no snapshots", n, secondsSince(start));
+
+    deque<PersistentAVLTree<int, int> > kept;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; i++){
+        if(keys[i] % 2 == 0){
+            persistent.insert(make_pair(keys[i], (int)i));
+        }
+        else{
+            persistent.remove(keys[i] - 1);
+        }
+        if(i % SNAPSHOT_EVERY == 0){
+            kept.push_back(persistent.snapshot());
+            if(kept.size() > KEPT){
+                kept.pop_front();
+            }
+        }
+    }
+    report("persistent, with snapshots", n, secondsSince(start));
+
+    // Each version holds its own size() nodes less those it shares with
+    // the next newer one; a node dropped from one version is in no later one.
+    size_t nodes = persistent.size();
+    for(size_t i = 0; i < kept.size(); i++){
+        const PersistentAVLTree<int, int>& newer = (i + 1 < kept.size()) ? kept[i + 1] : persistent;
+        nodes += kept[i].size() - kept[i].sharedNodes(newer);
+    }
+    printf("%zu snapshots every %zu writes: %zu nodes for %zu items, %.1f%% extra (full copies: %zu%%)\n",
+        kept.size(), SNAPSHOT_EVERY, nodes, persistent.size(), 100.0 * (nodes - persistent.size()) / persistent.size(), 100 * kept.size());
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef BST_HEAP_NODES
+    printf("node storage: heap\n");
+#else
+    printf("node storage: pool\n");
+#endif
+    size_t sizes[] = {100000, 1000000};
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        printf("AVLTree (%zu byte nodes)\n", sizeof(AVLNode<int, int>));
+        benchAll<AVLTree<int, int> >(sizes[s]);
+        printf("CompactAVLTree (%zu byte nodes)\n", sizeof(CompactAVLNode<int, int>));
+        benchAll<CompactAVLTree<int, int> >(sizes[s]);
+        printf("StackAVLTree (%zu byte nodes)\n", sizeof(StackAVLNode<int, int>));
+        benchAll<StackAVLTree<int, int> >(sizes[s]);
+        printf("BTree (order %zu, %zu byte leaves)\n", BTree<int, int>::ORDER, sizeof(BTreeLeaf<int, int>));
+        benchAll<BTree<int, int> >(sizes[s]);
+        printf("std::map\n");
+        benchAll<StdMap>(sizes[s]);
+    }
+    benchFrozen(100000);
+    benchFrozen(10000000);
+    benchClone(100000);
+    benchClone(1000000);
+    benchUpsert(1000000);
+    benchSweep(1000000);
+    benchScan(1000);
+    benchScan(10000);
+    benchScan(100000);
+    benchScan(1000000);
+    benchShared(1000000);
+    benchSnapshot(100000);
+    benchSnapshot(1000000);
+    return 0;
+}
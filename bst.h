@@ -5,20 +5,34 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <tuple>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <future>
+#include <type_traits>
+#include "nodepool.h"
+#include "frozenbst.h"
+#include "frozenbtree.h"
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * Derived kinds of nodes (AVLNode, ...) redefine the getters for
+ * parent/left/right to return their own type. Nothing here is
+ * virtual: a tree always knows the concrete type of its nodes, so
+ * nodes carry no vtable pointer and every step of a search can be
+ * inlined.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    Node(Node<Key, Value>* parent, Args&&... args);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,14 +40,15 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
 
 protected:
     std::pair<const Key, Value> item_;
@@ -61,6 +76,22 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructs the item in place from args, as the constructors of
+* std::pair<const Key, Value> take them (a pair to copy or move from, a
+* key and a value, or std::piecewise_construct and two tuples).
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(Node<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
@@ -118,7 +149,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +158,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +167,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,37 +211,98 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* Same as above, moving the new value in.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* True when Compare orders Key with a single machine compare: scalar
+* keys under std::less or std::greater. Lookups in such trees can test
+* for equality on the way down for free; see internalFindParent.
+*/
+template<typename Key, typename Compare>
+struct ScalarCompare
+{
+    static const bool value = std::is_scalar<Key>::value &&
+        (std::is_same<Compare, std::less<Key> >::value || std::is_same<Compare, std::greater<Key> >::value);
+};
+
 /**
 * A templated unbalanced binary search tree.
+*
+* insert, remove and clear are virtual so that a derived tree works
+* through a BinarySearchTree&. Everything below them is statically
+* dispatched: the shared algorithms (insertWith, assignWith, clearWith,
+* ...) are templated on the tree type and call its hooks (createNode,
+* updatePath, ...) directly, so a derived tree redefines the hooks it
+* needs without any virtual call on the search or update paths.
+*
+* Keys are ordered by Compare, a strict weak ordering like std::less.
+* Searches make a single comp_ call per level and test for equality once
+* at the bottom (see internalDescend), so a costly key comparison
+* (strings, composite keys) is paid once per level rather than twice.
+* Only scalar keys in their natural order, where the two tests are one
+* machine compare, keep stopping early at an equal key.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
+    template<typename ForwardIt>
+    BinarySearchTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    BinarySearchTree(const BinarySearchTree<Key, Value, Compare>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value, Compare>&& other);
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree<Key, Value, Compare>& operator=(BinarySearchTree<Key, Value, Compare> other);
+    void swap(BinarySearchTree<Key, Value, Compare>& other);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    virtual void insert(std::pair<const Key, Value>&& keyValuePair);
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    void remove(const K& key);
+    virtual void clear(); //TODO
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+    template<typename InputIt>
+    void assignUnsorted(InputIt first, InputIt last);
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    Compare key_comp() const;
+    BinarySearchTree<Key, Value, Compare> clone(unsigned int threads = 1) const;
 
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    template<typename PPKey, typename PPValue, typename PPCompare>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue, PPCompare> & tree);
 public:
+    class const_iterator;
+
     /**
     * An internal iterator class for traversing the contents of the BST.
+    * It is bidirectional: decrementing end() reaches the largest item,
+    * which is why the iterator remembers its tree.
     */
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -218,46 +310,250 @@ public:
 
         bool operator==(const iterator& rhs) const;
         bool operator!=(const iterator& rhs) const;
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare>;
+        friend class const_iterator;
+        iterator(const BinarySearchTree<Key, Value, Compare>* tree, Node<Key,Value>* ptr);
+        const BinarySearchTree<Key, Value, Compare>* tree_;
+        Node<Key, Value> *current_;
+    };
+
+    /**
+    * As iterator, but the items it reaches are read-only. An iterator
+    * converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class iterator;
+        const BinarySearchTree<Key, Value, Compare>* tree_;
         Node<Key, Value> *current_;
     };
 
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    /**
+    * A [first, last) pair of iterators that can be walked with a
+    * range-based for loop; returned by range().
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
 public:
     iterator begin() const;
     iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    size_t count(const Key& key) const;
+
+    // Lookups by any type K that Compare can order against Key, for a
+    // Compare that declares is_transparent (as std::less<> does).
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t count(const K& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+    FrozenBTree<Key, Value> freezeBlocks() const;
+    iterator insert(iterator hint, const std::pair<const Key, Value>& keyValuePair);
+    iterator insert(iterator hint, std::pair<const Key, Value>&& keyValuePair);
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+    template<typename Pred>
+    size_t erase_if(Pred pred);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& obj);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, M&& obj);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    Value& operator[](const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    Value const & operator[](const K& key) const;
+    Value* get(const Key& key);
+    const Value* get(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    Value* get(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const Value* get(const K& key) const;
+    std::pair<Value&, bool> find_or_insert(const Key& key, const Value& value = Value());
+    template<typename F>
+    bool update(const Key& key, F fn);
 
     Node<Key, Value>* getRoot() const{ return root_;}
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* internalFind(const K& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value> *getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
     // Provided helper functions
-    virtual void printRoot (Node<Key, Value> *r) const;
-    virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
+    void printRoot (Node<Key, Value> *r) const;
+    void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
     static Node<Key, Value>* successor(Node<Key, Value>* current);
+    static Node<Key, Value>* ancestorPredecessor(Node<Key, Value>* curr);
+    static Node<Key, Value>* ancestorSuccessor(Node<Key, Value>* curr);
 
     // Add helper functions here
-    virtual int subheight(Node<Key,Value>* root) const;
-    virtual bool isBalanced(Node<Key, Value>* curr) const;
-
-private:
-    void clearHelper(Node<Key, Value>* curr);
+    template<typename K>
+    Node<Key, Value>* internalDescend(const K& key, bool& wentLeft) const;
+    template<typename K>
+    Node<Key, Value>* internalFindParent(const K& key, Node<Key, Value>*& parent) const;
+    template<typename K>
+    Node<Key, Value>* internalFindParent(const K& key, Node<Key, Value>*& parent, std::true_type scalar) const;
+    template<typename K>
+    Node<Key, Value>* internalFindParent(const K& key, Node<Key, Value>*& parent, std::false_type scalar) const;
+    template<typename K>
+    Node<Key, Value>* internalLowerBound(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* internalUpperBound(const K& key) const;
+    Node<Key, Value>* hintFindParent(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent) const;
+    iterator makeIterator(Node<Key, Value>* curr) const;
+    void setRoot(Node<Key, Value>* root);
+    void resetEnds();
+    void unlinkEnds(Node<Key, Value>* curr);
+    int subheight(Node<Key,Value>* root) const;
+    bool isBalanced(Node<Key, Value>* curr) const;
+
+    // Hooks for derived trees, which redefine the ones they need. They are
+    // called through the Tree parameter of the algorithms below.
+    Node<Key, Value>* insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* curr);
+    void removeNode(Node<Key, Value>* curr);
+    void publishLeft(Node<Key, Value>* parent, Node<Key, Value>* child);
+    void publishRight(Node<Key, Value>* parent, Node<Key, Value>* child);
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    Node<Key, Value>* cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent);
+    void destroyNode(Node<Key, Value>* curr);
+    bool trivialNodes() const;
+    void buildFix(Node<Key, Value>* curr, int leftHeight, int rightHeight);
+    void updateNode(Node<Key, Value>* curr);
+    void updatePath(Node<Key, Value>* curr);
+    void updateValue(Node<Key, Value>* curr);
+
+    // Node storage shared by every kind of node.
+    template<typename NodeType>
+    void* allocateNode();
+    template<typename NodeType>
+    void freeNode(NodeType* curr);
+
+    // Algorithms shared by every tree, dispatching to the hooks of Tree.
+    template<typename Tree, typename Pair>
+    static void insertWith(Tree& tree, Pair&& keyValuePair);
+    template<typename Tree, typename Pair>
+    static iterator insertWith(Tree& tree, iterator hint, Pair&& keyValuePair);
+    template<typename Tree, typename... Args>
+    static std::pair<iterator, bool> emplaceWith(Tree& tree, Args&&... args);
+    template<typename Tree, typename K, typename... Args>
+    static std::pair<iterator, bool> tryEmplaceWith(Tree& tree, K&& key, Args&&... args);
+    template<typename Tree, typename K, typename M>
+    static std::pair<iterator, bool> insertOrAssignWith(Tree& tree, K&& key, M&& obj);
+    template<typename Tree>
+    static std::pair<Node<Key, Value>*, bool> findOrInsertWith(Tree& tree, const Key& key, const Value& value);
+    template<typename Tree, typename F>
+    static bool updateWith(Tree& tree, const Key& key, F& fn);
+    template<typename Tree>
+    static iterator eraseWith(Tree& tree, iterator first, iterator last);
+    template<typename Tree, typename Pred>
+    static size_t eraseIfWith(Tree& tree, Pred& pred);
+    template<typename Tree>
+    static Node<Key, Value>* linkLeaf(Tree& tree, Node<Key, Value>* parent, Node<Key, Value>* curr);
+    template<typename Tree>
+    static void nodeSwapWith(Tree& tree, Node<Key, Value>* n1, Node<Key, Value>* n2);
+    template<typename Tree, typename ForwardIt>
+    static void assignWith(Tree& tree, ForwardIt first, ForwardIt last);
+    template<typename Tree>
+    static void cloneWith(Tree& tree, const Tree& other, unsigned int threads);
+    template<typename Tree>
+    static Node<Key, Value>* cloneNodes(Tree& tree, Node<Key, Value>* src, Node<Key, Value>* parent);
+    template<typename Tree>
+    static Node<Key, Value>* cloneParallel(Tree& tree, const Tree& empty, Node<Key, Value>* src,
+                                           Node<Key, Value>* parent, unsigned int threads);
+    template<typename Tree, typename ForwardIt>
+    static Node<Key, Value>* buildSorted(Tree& tree, ForwardIt& first, size_t count, Node<Key, Value>* parent, int& height);
+    template<typename Tree>
+    static void clearWith(Tree& tree);
+    template<typename Tree>
+    static void clearHelper(Tree& tree, Node<Key, Value>* curr);
+    template<typename InputIt>
+    static std::vector<std::pair<Key, Value> > sortedUnique(InputIt first, InputIt last, const Compare& comp);
 
 protected:
     Node<Key, Value>* root_;
+    // The smallest and largest nodes, kept up to date by linkLeaf and
+    // removeNode and reset after every bulk change, so begin(), --end()
+    // and hints at either end cost O(1).
+    Node<Key, Value>* leftmost_;
+    Node<Key, Value>* rightmost_;
+    Compare comp_;
+    NodePool pool_;
     // You should not need other data members
 };
 
@@ -270,29 +566,31 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(const BinarySearchTree<Key, Value, Compare>* tree, Node<Key,Value> *ptr)
 {
     // TODO
+    tree_ = tree;
     current_ = ptr;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
+    tree_ = NULL;
     current_ = NULL;
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -300,63 +598,93 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
 
 /**
-* Checks if 'this' iterator's internals have the same value
-* as 'rhs'
+* Checks if 'this' iterator is at the same node as 'rhs'. Nodes are
+* compared by address only, so two items that happen to hold equal
+* values are still different positions; every end() iterator is equal
+* to every other one.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
-    if(current_ == rhs.current_){
-        return true;
-    }
-    if((current_ == nullptr) || ((rhs.current_) == nullptr)){
-        return false;
-    }
-    return (((current_)->getValue()) == ((rhs.current_)->getValue()));
+    return (current_ == rhs.current_);
 }
 
 /**
-* Checks if 'this' iterator's internals have a different value
-* as 'rhs'
+* Checks if 'this' iterator is at a different node than 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
-    if(current_ == rhs.current_){
-        return false;
-    }
-    if((current_ == nullptr) || ((rhs.current_) == nullptr)){
-        return true;
-    }
-    return (((current_)->getValue()) != ((rhs.current_)->getValue()));
+    return (current_ != rhs.current_);
+}
+
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return (current_ == rhs.current_);
 }
 
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return (current_ != rhs.current_);
+}
 
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator& BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
     // TODO
     current_ = successor(current_);
     return (*this);
 }
 
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator BinarySearchTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    current_ = successor(current_);
+    return old;
+}
+
+/**
+* Moves the iterator back one item; from end() that is the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator& BinarySearchTree<Key, Value, Compare>::iterator::operator--()
+{
+    current_ = (current_ == nullptr) ? tree_->getLargestNode() : predecessor(current_);
+    return (*this);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator BinarySearchTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
 
 /*
 -------------------------------------------------------------
@@ -364,6 +692,127 @@ End implementations for the BinarySearchTree::iterator class.
 -------------------------------------------------------------
 */
 
+/*
+-------------------------------------------------------------------
+Begin implementations for the BinarySearchTree::const_iterator class.
+-------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    tree_(nullptr),
+    current_(nullptr)
+{
+
+}
+
+/**
+* The read-only iterator at the same item as it.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator(const iterator& it) :
+    tree_(it.tree_),
+    current_(it.current_)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return (current_ == rhs.current_);
+}
+
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return (current_ != rhs.current_);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator& BinarySearchTree<Key, Value, Compare>::const_iterator::operator++()
+{
+    current_ = successor(current_);
+    return (*this);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator BinarySearchTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    current_ = successor(current_);
+    return old;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator& BinarySearchTree<Key, Value, Compare>::const_iterator::operator--()
+{
+    current_ = (current_ == nullptr) ? tree_->getLargestNode() : predecessor(current_);
+    return (*this);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator BinarySearchTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+-----------------------------------------------------------------
+End implementations for the BinarySearchTree::const_iterator class.
+-----------------------------------------------------------------
+*/
+
+/**
+* Wraps the iterators [first, last).
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator_range::end() const
+{
+    return last_;
+}
+
+/**
+* Returns true if the range holds no items.
+*/
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::iterator_range::empty() const
+{
+    return first_.current_ == last_.current_;
+}
+
 /*
 -----------------------------------------------------
 Begin implementations for the BinarySearchTree class.
@@ -373,31 +822,138 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree() 
 {
     // TODO
     root_ = nullptr;
+    leftmost_ = nullptr;
+    rightmost_ = nullptr;
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* An empty tree ordered by comp.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const Compare& comp) :
+    comp_(comp)
+{
+    root_ = nullptr;
+    leftmost_ = nullptr;
+    rightmost_ = nullptr;
+}
+
+/**
+* Builds a perfectly balanced tree from a range sorted by strictly
+* increasing key under comp, in O(n).
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    comp_(comp)
+{
+    root_ = nullptr;
+    leftmost_ = nullptr;
+    rightmost_ = nullptr;
+    assign(first, last);
+}
+
+/**
+* A deep copy of other with the same shape, made in O(n) without
+* comparing any keys; see cloneWith.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const BinarySearchTree<Key, Value, Compare>& other) :
+    comp_(other.comp_)
+{
+    root_ = nullptr;
+    leftmost_ = nullptr;
+    rightmost_ = nullptr;
+    cloneWith(*this, other, 1);
+}
+
+/**
+* Takes over other's nodes and their storage in O(1), leaving other empty.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(BinarySearchTree<Key, Value, Compare>&& other) :
+    root_(other.root_),
+    leftmost_(other.leftmost_),
+    rightmost_(other.rightmost_),
+    comp_(other.comp_)
+{
+    other.root_ = nullptr;
+    other.leftmost_ = nullptr;
+    other.rightmost_ = nullptr;
+    pool_.swap(other.pool_);
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
     // TODO
     clear();
 }
 
+/**
+* Copy or move assignment: other was built by the copy or move
+* constructor, so taking its contents is a swap, and the old nodes go
+* away with other.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>& BinarySearchTree<Key, Value, Compare>::operator=(BinarySearchTree<Key, Value, Compare> other)
+{
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1). Iterators stay valid and
+* now refer into the other tree.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::swap(BinarySearchTree<Key, Value, Compare>& other)
+{
+    std::swap(root_, other.root_);
+    std::swap(leftmost_, other.leftmost_);
+    std::swap(rightmost_, other.rightmost_);
+    std::swap(comp_, other.comp_);
+    pool_.swap(other.pool_);
+}
+
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
     return root_ == NULL;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Returns a copy of the tree with the same shape, in O(n). With threads
+* greater than 1, large subtrees are copied concurrently, which pays off
+* for trees of many thousands of nodes.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare>::clone(unsigned int threads) const
+{
+    BinarySearchTree<Key, Value, Compare> copy(comp_);
+    cloneWith(copy, *this, threads);
+    return copy;
+}
+
+/**
+* Returns a copy of the ordering the tree was built with.
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
@@ -406,111 +962,1088 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(this, getSmallestNode());
     return begin;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(this, NULL);
     return end;
 }
 
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cbegin() const
+{
+    return const_iterator(begin());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cend() const
+{
+    return const_iterator(end());
+}
+
+/**
+* Reverse iterators walk the tree from the largest item down; they rely
+* on decrementing end().
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crbegin() const
+{
+    return const_reverse_iterator(cend());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crend() const
+{
+    return const_reverse_iterator(cbegin());
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value, Compare>::iterator it(this, curr);
     return it;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const Key& key) const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    return iterator(this, internalLowerBound(key));
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upper_bound(const Key& key) const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    return iterator(this, internalUpperBound(key));
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+* Returns [lower_bound(key), upper_bound(key)). Keys are unique, so the
+* range holds at most one item and the upper end is its successor.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, typename BinarySearchTree<Key, Value, Compare>::iterator>
+BinarySearchTree<Key, Value, Compare>::equal_range(const Key& key) const
 {
-    // TODO
-    Node<Key, Value>* curr = root_;
-    Node<Key, Value>* prev = root_;
-    if(root_ == nullptr){
-        curr = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
-        root_ = curr;
-        return;
-    }
-    while(curr != nullptr){
-        prev = curr;
-        if(keyValuePair.first == (curr->getKey())){
-            curr->setValue(keyValuePair.second);
-            return;
-        }
-        else if(keyValuePair.first < (curr->getKey())){
-            curr = curr->getLeft();
-        }
-        else{
-            curr = curr->getRight();
-        }
-    }
-    curr = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, prev);
-    if(keyValuePair.first < (prev->getKey())){
-        prev->setLeft(curr);
-        return;
-    }
-    else{
-        prev->setRight(curr);
-        return;
+    Node<Key, Value>* first = internalLowerBound(key);
+    Node<Key, Value>* last = first;
+    if((first != nullptr) && !comp_(key, first->getKey())){
+        last = successor(first);
     }
+    return std::make_pair(iterator(this, first), iterator(this, last));
 }
 
+/**
+* Returns the number of items with the given key: 1 or 0.
+*/
+template<class Key, class Value, class Compare>
+size_t BinarySearchTree<Key, Value, Compare>::count(const Key& key) const
+{
+    return (internalFind(key) != nullptr) ? 1 : 0;
+}
 
 /*
-* A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+ * The heterogeneous lookups below search with key as it is, so looking
+ * up a std::string key by a const char* builds no std::string. They only
+ * exist when Compare is transparent, since an ordinary Compare would
+ * convert key to a Key on every call anyway.
+ */
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& key) const
+{
+    return iterator(this, internalFind(key));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const K& key) const
+{
+    return iterator(this, internalLowerBound(key));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upper_bound(const K& key) const
+{
+    return iterator(this, internalUpperBound(key));
+}
+
+/**
+* As equal_range(const Key&). A transparent Compare may treat several
+* keys as equivalent to key, so the range runs to the upper bound.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, typename BinarySearchTree<Key, Value, Compare>::iterator>
+BinarySearchTree<Key, Value, Compare>::equal_range(const K& key) const
 {
-    Node<Key, Value>* curr = internalFind(key);
-    if((root_ == nullptr) || (curr == nullptr)){
-        return;
+    return std::make_pair(iterator(this, internalLowerBound(key)), iterator(this, internalUpperBound(key)));
+}
+
+/**
+* Returns the number of items whose key is equivalent to key.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+size_t BinarySearchTree<Key, Value, Compare>::count(const K& key) const
+{
+    size_t total = 0;
+    Node<Key, Value>* last = internalUpperBound(key);
+    for(Node<Key, Value>* curr = internalLowerBound(key); curr != last; curr = successor(curr)){
+        total++;
+    }
+    return total;
+}
+
+/**
+* Returns the items with lo <= key < hi, in order. Finding both ends
+* takes two descents and walking the k items in between is O(k)
+* amortized, so a full scan costs O(log n + k). The range is empty
+* unless lo < hi.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator_range
+BinarySearchTree<Key, Value, Compare>::range(const Key& lo, const Key& hi) const
+{
+    Node<Key, Value>* first = internalLowerBound(lo);
+    if(!comp_(lo, hi)){
+        return iterator_range(iterator(this, first), iterator(this, first));
+    }
+    return iterator_range(iterator(this, first), iterator(this, internalLowerBound(hi)));
+}
+
+/**
+* Returns an immutable copy of the tree laid out for fast lookups; see
+* FrozenTree. Later changes to the tree do not affect it.
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(begin(), end(), comp_);
+}
+
+/**
+* As freeze(), but laid out as a static B-tree searched a block at a time
+* with SIMD kernels where the key type has them; see FrozenBTree. The
+* kernels compare keys with <, so this needs the default ordering.
+*/
+template<class Key, class Value, class Compare>
+FrozenBTree<Key, Value> BinarySearchTree<Key, Value, Compare>::freezeBlocks() const
+{
+    static_assert(std::is_same<Compare, std::less<Key> >::value, "freezeBlocks() needs a tree ordered by std::less");
+    return FrozenBTree<Key, Value>(begin(), end());
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* As above, looking key up without converting it to a Key.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const K& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const K& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* Returns a pointer to the value of key, or NULL if key is not in the
+* tree. The pointer stays valid until the item is removed.
+*/
+template<class Key, class Value, class Compare>
+Value* BinarySearchTree<Key, Value, Compare>::get(const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return (curr == nullptr) ? nullptr : &curr->getValue();
+}
+
+template<class Key, class Value, class Compare>
+const Value* BinarySearchTree<Key, Value, Compare>::get(const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return (curr == nullptr) ? nullptr : &curr->getValue();
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+Value* BinarySearchTree<Key, Value, Compare>::get(const K& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return (curr == nullptr) ? nullptr : &curr->getValue();
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+const Value* BinarySearchTree<Key, Value, Compare>::get(const K& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return (curr == nullptr) ? nullptr : &curr->getValue();
+}
+
+/**
+* Returns the value of key, first inserting key with value if it is not
+* in the tree, and whether it was inserted. Unlike find followed by
+* insert this descends once.
+*/
+template<class Key, class Value, class Compare>
+std::pair<Value&, bool> BinarySearchTree<Key, Value, Compare>::find_or_insert(const Key& key, const Value& value)
+{
+    std::pair<Node<Key, Value>*, bool> result = findOrInsertWith(*this, key, value);
+    return std::pair<Value&, bool>(result.first->getValue(), result.second);
+}
+
+/**
+* Calls fn on the value of key in place, if key is in the tree, and
+* returns whether it was.
+*/
+template<class Key, class Value, class Compare>
+template<typename F>
+bool BinarySearchTree<Key, Value, Compare>::update(const Key& key, F fn)
+{
+    return updateWith(*this, key, fn);
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    // TODO
+    insertWith(*this, keyValuePair);
+}
+
+/**
+* Same as above, moving the value (the key is const, so it is copied)
+* into the tree instead of copying it.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(std::pair<const Key, Value> &&keyValuePair)
+{
+    insertWith(*this, std::move(keyValuePair));
+}
+
+/**
+* Inserts (or overwrites) keyValuePair using hint as a starting point.
+* When the key belongs right before or right after hint (end() meaning
+* after the largest key) it is attached without descending from the root;
+* otherwise this falls back to a normal insert. Returns an iterator to
+* the inserted or updated item.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, const std::pair<const Key, Value> &keyValuePair)
+{
+    return insertWith(*this, hint, keyValuePair);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, std::pair<const Key, Value> &&keyValuePair)
+{
+    return insertWith(*this, hint, std::move(keyValuePair));
+}
+
+/**
+* Inserts an item constructed in place from args, as std::map::emplace
+* does. The node has to be built to learn its key, so if the key is
+* already present it is thrown away again and the tree is unchanged.
+* Returns an iterator to the item with that key and whether it is new.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+    return emplaceWith(*this, std::forward<Args>(args)...);
+}
+
+/**
+* If key is not in the tree, inserts it with a value constructed in place
+* from args. Otherwise nothing happens, and in particular args are not
+* moved from. Returns an iterator to the item with key and whether it is
+* new.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+    return tryEmplaceWith(*this, key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(Key&& key, Args&&... args)
+{
+    return tryEmplaceWith(*this, std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Assigns obj to the value of key if it is in the tree, and otherwise
+* inserts key with a value constructed from obj. Returns an iterator to
+* the item and true if it was inserted, false if assigned.
+*/
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(const Key& key, M&& obj)
+{
+    return insertOrAssignWith(*this, key, std::forward<M>(obj));
+}
+
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(Key&& key, M&& obj)
+{
+    return insertOrAssignWith(*this, std::move(key), std::forward<M>(obj));
+}
+
+/**
+* The single-descent insert shared by every tree: overwrite the value if
+* the key is present, otherwise build a node from keyValuePair (copying
+* or moving, as Pair says) and hand it to tree.insertLeaf.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename Pair>
+void BinarySearchTree<Key, Value, Compare>::insertWith(Tree& tree, Pair&& keyValuePair)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* curr = tree.internalFindParent(keyValuePair.first, parent);
+    if(curr != nullptr){
+        curr->setValue(std::forward<Pair>(keyValuePair).second);
+        tree.updateValue(curr);
+        return;
+    }
+    tree.insertLeaf(parent, tree.createNode(parent, std::forward<Pair>(keyValuePair)));
+}
+
+/**
+* The hinted insert shared by every tree.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename Pair>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insertWith(Tree& tree, iterator hint, Pair&& keyValuePair)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* curr = tree.hintFindParent(hint.current_, keyValuePair.first, parent);
+    if(curr != nullptr){
+        curr->setValue(std::forward<Pair>(keyValuePair).second);
+        tree.updateValue(curr);
+        return iterator(&tree, curr);
+    }
+    return iterator(&tree, tree.insertLeaf(parent, tree.createNode(parent, std::forward<Pair>(keyValuePair))));
+}
+
+/**
+* The emplace shared by every tree.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplaceWith(Tree& tree, Args&&... args)
+{
+    Node<Key, Value>* curr = tree.createNode(nullptr, std::forward<Args>(args)...);
+    Node<Key, Value>* parent;
+    Node<Key, Value>* found = tree.internalFindParent(curr->getKey(), parent);
+    if(found != nullptr){
+        tree.destroyNode(curr);
+        return std::make_pair(iterator(&tree, found), false);
+    }
+    return std::make_pair(iterator(&tree, tree.insertLeaf(parent, curr)), true);
+}
+
+/**
+* The try_emplace shared by every tree. The key is only copied or moved
+* into a node once it is known to be missing.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplaceWith(Tree& tree, K&& key, Args&&... args)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* curr = tree.internalFindParent(key, parent);
+    if(curr != nullptr){
+        return std::make_pair(iterator(&tree, curr), false);
+    }
+    curr = tree.createNode(parent, std::piecewise_construct,
+                           std::forward_as_tuple(std::forward<K>(key)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(iterator(&tree, tree.insertLeaf(parent, curr)), true);
+}
+
+/**
+* The insert_or_assign shared by every tree.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename K, typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insertOrAssignWith(Tree& tree, K&& key, M&& obj)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* curr = tree.internalFindParent(key, parent);
+    if(curr != nullptr){
+        curr->getValue() = std::forward<M>(obj);
+        tree.updateValue(curr);
+        return std::make_pair(iterator(&tree, curr), false);
+    }
+    curr = tree.createNode(parent, std::forward<K>(key), std::forward<M>(obj));
+    return std::make_pair(iterator(&tree, tree.insertLeaf(parent, curr)), true);
+}
+
+/**
+* The find_or_insert shared by every tree. Returns the node rather than
+* the value so that a tree can wrap the value as it needs to.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree>
+std::pair<Node<Key, Value>*, bool>
+BinarySearchTree<Key, Value, Compare>::findOrInsertWith(Tree& tree, const Key& key, const Value& value)
+{
+    std::pair<iterator, bool> result = tryEmplaceWith(tree, key, value);
+    return std::make_pair(result.first.current_, result.second);
+}
+
+/**
+* The update shared by every tree. The value changed, so the tree's
+* updateValue hook runs afterwards.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename F>
+bool BinarySearchTree<Key, Value, Compare>::updateWith(Tree& tree, const Key& key, F& fn)
+{
+    Node<Key, Value>* curr = tree.internalFind(key);
+    if(curr == nullptr){
+        return false;
+    }
+    fn(curr->getValue());
+    tree.updateValue(curr);
+    return true;
+}
+
+/**
+* Links curr, a node made by createNode, as a leaf under parent (as the
+* root if parent is NULL) and returns it. Derived trees redefine this to
+* rebalance.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* curr)
+{
+    return linkLeaf(*this, parent, curr);
+}
+
+/**
+* Links curr as a leaf under parent on the side its key belongs, then
+* refreshes the path above it. A leaf hung left of the smallest node or
+* right of the largest one becomes the new end.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::linkLeaf(Tree& tree, Node<Key, Value>* parent, Node<Key, Value>* curr)
+{
+    curr->setParent(parent);
+    if(parent == nullptr){
+        tree.leftmost_ = curr;
+        tree.rightmost_ = curr;
+        tree.setRoot(curr);
+    }
+    else if(tree.comp_(curr->getKey(), parent->getKey())){
+        if(parent == tree.leftmost_){
+            tree.leftmost_ = curr;
+        }
+        tree.publishLeft(parent, curr);
+    }
+    else{
+        if(parent == tree.rightmost_){
+            tree.rightmost_ = curr;
+        }
+        tree.publishRight(parent, curr);
+    }
+    tree.updatePath(parent);
+    return curr;
+}
+
+
+/**
+* Allocates a node of the kind this tree stores under parent, with its
+* item constructed in place from args.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (allocateNode<Node<Key, Value> >()) Node<Key, Value>(parent, std::forward<Args>(args)...);
+}
+
+/**
+* Creates a copy of src under parent, for cloneWith. Derived trees that
+* keep more in a node copy that too.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent)
+{
+    return createNode(parent, src->getItem());
+}
+
+/**
+* Destroys a node made by createNode and gives back its storage.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* curr)
+{
+    freeNode(curr);
+}
+
+/**
+* Returns storage for one NodeType. Nodes come from the tree's NodePool
+* unless BST_HEAP_NODES is defined, in which case every node is a
+* separate heap allocation.
+*/
+template<class Key, class Value, class Compare>
+template<typename NodeType>
+void* BinarySearchTree<Key, Value, Compare>::allocateNode()
+{
+#ifdef BST_HEAP_NODES
+    return ::operator new(sizeof(NodeType));
+#else
+    return pool_.allocate(sizeof(NodeType), alignof(NodeType));
+#endif
+}
+
+/**
+* Runs the destructor of curr, whose exact type is NodeType, and gives
+* back its storage.
+*/
+template<class Key, class Value, class Compare>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Compare>::freeNode(NodeType* curr)
+{
+    curr->~NodeType();
+#ifdef BST_HEAP_NODES
+    ::operator delete(curr);
+#else
+    pool_.deallocate(curr);
+#endif
+}
+
+/**
+* Returns true if the nodes of this tree need no destructor, so clear()
+* can drop them with their slabs instead of visiting each one. Derived
+* trees that store more than the key and value in a node extend this.
+*/
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::trivialNodes() const
+{
+    return std::is_trivially_destructible<Key>::value && std::is_trivially_destructible<Value>::value;
+}
+
+/**
+* Called by buildSorted once both subtrees of curr are linked, with their
+* heights. A plain BST keeps nothing per node, so there is nothing to do.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::buildFix(Node<Key, Value>* curr, int leftHeight, int rightHeight)
+{
+
+}
+
+/**
+* Recomputes whatever a derived tree stores in curr about its subtree,
+* assuming its children are up to date. Called after every change to
+* curr's children; a plain BST stores nothing.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::updateNode(Node<Key, Value>* curr)
+{
+
+}
+
+/**
+* Calls updateNode on curr and each of its ancestors, after a node was
+* linked or unlinked below curr. A plain BST skips the walk entirely.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::updatePath(Node<Key, Value>* curr)
+{
+
+}
+
+/**
+* Called after the value stored in curr was overwritten in place, for
+* trees that keep something derived from values. Nothing to do here.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::updateValue(Node<Key, Value>* curr)
+{
+
+}
+
+/**
+* Wraps a node in an iterator, for derived trees that find nodes on
+* their own.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::makeIterator(Node<Key, Value>* curr) const
+{
+    return iterator(this, curr);
+}
+
+/**
+* Makes root the root node. Like publishLeft and publishRight this is a
+* hook: the insert, remove and rotation paths relink the root through
+* the tree, so a tree with concurrent readers can order the store.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::setRoot(Node<Key, Value>* root)
+{
+    root_ = root;
+}
+
+/**
+* Links child as the left child of parent. The insert, remove and
+* rotation paths link existing trees through this hook and publishRight;
+* a plain store here, see ConcurrentAVLTree for the ordered one.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::publishLeft(Node<Key, Value>* parent, Node<Key, Value>* child)
+{
+    parent->setLeft(child);
+}
+
+/**
+* Links child as the right child of parent; see publishLeft.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::publishRight(Node<Key, Value>* parent, Node<Key, Value>* child)
+{
+    parent->setRight(child);
+}
+
+/**
+* Finds leftmost_ and rightmost_ again by walking both spines, O(log n).
+* Called whenever whole subtrees were built or moved around without
+* going through linkLeaf and removeNode.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::resetEnds()
+{
+    leftmost_ = root_;
+    while((leftmost_ != nullptr) && ((leftmost_->getLeft()) != nullptr)){
+        leftmost_ = leftmost_->getLeft();
+    }
+    rightmost_ = root_;
+    while((rightmost_ != nullptr) && ((rightmost_->getRight()) != nullptr)){
+        rightmost_ = rightmost_->getRight();
+    }
+}
+
+/**
+* Moves leftmost_ and rightmost_ off curr, which is about to be removed,
+* to its in-order neighbours. An end has no child on its outer side, so
+* this is a short step in practice.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::unlinkEnds(Node<Key, Value>* curr)
+{
+    if(curr == leftmost_){
+        leftmost_ = successor(curr);
+    }
+    if(curr == rightmost_){
+        rightmost_ = predecessor(curr);
+    }
+}
+
+/**
+* Replaces the contents of the tree with a range sorted by strictly
+* increasing key. The tree is built perfectly balanced in O(n) without
+* any comparisons.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+void BinarySearchTree<Key, Value, Compare>::assign(ForwardIt first, ForwardIt last)
+{
+    assignWith(*this, first, last);
+}
+
+/**
+* Like assign, but for a range in any order. The items are sorted first
+* and, for repeated keys, the last one wins, as with repeated inserts.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare>::assignUnsorted(InputIt first, InputIt last)
+{
+    std::vector<std::pair<Key, Value> > items = sortedUnique(first, last, comp_);
+    assign(items.begin(), items.end());
+}
+
+/**
+* The bulk build shared by every tree.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename ForwardIt>
+void BinarySearchTree<Key, Value, Compare>::assignWith(Tree& tree, ForwardIt first, ForwardIt last)
+{
+    clearWith(tree);
+    int height;
+    tree.root_ = buildSorted(tree, first, std::distance(first, last), nullptr, height);
+    tree.resetEnds();
+}
+
+/**
+* Replaces the contents of tree with a copy of other, node for node: each
+* copy gets the same place in the tree and whatever the node keeps about
+* its subtree (balance, size, ...) through tree.cloneNode, so nothing is
+* compared or rebalanced. With threads > 1 large subtrees are copied
+* concurrently; see cloneParallel.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree>
+void BinarySearchTree<Key, Value, Compare>::cloneWith(Tree& tree, const Tree& other, unsigned int threads)
+{
+    clearWith(tree);
+    if(threads > 1){
+        Tree empty(tree);
+        tree.root_ = cloneParallel(tree, empty, other.root_, nullptr, threads);
+    }
+    else{
+        tree.root_ = cloneNodes(tree, other.root_, nullptr);
+    }
+    tree.resetEnds();
+}
+
+/**
+* Copies the subtree rooted at src under parent and returns the copy.
+* This is a preorder walk without recursion: it follows left children,
+* setting each right subtree aside with the copy it hangs from, so every
+* node of src is read once. A right subtree is only set aside while the
+* walk is to the left of it, which keeps that list no longer than the
+* height of src and makes degenerate trees of any depth fine.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::cloneNodes(Tree& tree, Node<Key, Value>* src, Node<Key, Value>* parent)
+{
+    if(src == nullptr){
+        return nullptr;
+    }
+    std::vector<std::pair<Node<Key, Value>*, Node<Key, Value>*> > rights;
+    Node<Key, Value>* top = tree.cloneNode(src, parent);
+    Node<Key, Value>* from = src;
+    Node<Key, Value>* to = top;
+    while(true){
+        if(from->getRight() != nullptr){
+            rights.push_back(std::make_pair(from->getRight(), to));
+        }
+        if(from->getLeft() != nullptr){
+            from = from->getLeft();
+            Node<Key, Value>* curr = tree.cloneNode(from, to);
+            to->setLeft(curr);
+            to = curr;
+        }
+        else if(!rights.empty()){
+            from = rights.back().first;
+            Node<Key, Value>* above = rights.back().second;
+            rights.pop_back();
+            to = tree.cloneNode(from, above);
+            above->setRight(to);
+        }
+        else{
+            break;
+        }
+    }
+    return top;
+}
+
+/**
+* As cloneNodes, but while threads remain and src is large enough to pay
+* for a thread (its leftmost path is longer than 12 nodes), the left
+* subtree is copied on another thread. The pool is single threaded, so
+* that thread allocates from a tree of its own, an empty copy of empty;
+* once it is done tree adopts its slabs, as join does.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::cloneParallel(Tree& tree, const Tree& empty, Node<Key, Value>* src,
+                                                                      Node<Key, Value>* parent, unsigned int threads)
+{
+    int depth = 0;
+    for(Node<Key, Value>* curr = src; (curr != nullptr) && (depth <= 12); curr = curr->getLeft()){
+        depth++;
+    }
+    if((threads <= 1) || (depth <= 12)){
+        return cloneNodes(tree, src, parent);
+    }
+    Node<Key, Value>* curr = tree.cloneNode(src, parent);
+    Tree part(empty);
+    std::future<Node<Key, Value>*> pending = std::async(std::launch::async,
+        [&part, &empty, src, threads](){
+            return cloneParallel(part, empty, src->getLeft(), nullptr, threads / 2);
+        });
+    Node<Key, Value>* right = cloneParallel(tree, empty, src->getRight(), curr, threads - threads / 2);
+    Node<Key, Value>* left = pending.get();
+    curr->setLeft(left);
+    left->setParent(curr);
+    curr->setRight(right);
+    tree.pool_.adopt(part.pool_);
+    return curr;
+}
+
+/**
+* Copies a range into a vector sorted by key under comp, keeping only the
+* last item for each repeated key.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+std::vector<std::pair<Key, Value> > BinarySearchTree<Key, Value, Compare>::sortedUnique(InputIt first, InputIt last, const Compare& comp)
+{
+    std::vector<std::pair<Key, Value> > items(first, last);
+    std::stable_sort(items.begin(), items.end(),
+        [&comp](const std::pair<Key, Value>& lhs, const std::pair<Key, Value>& rhs){
+            return comp(lhs.first, rhs.first);
+        });
+    size_t count = 0;
+    for(size_t i = 0; i < items.size(); i++){
+        if((i + 1 < items.size()) && !comp(items[i].first, items[i + 1].first)){
+            continue;
+        }
+        if(count != i){
+            items[count] = items[i];
+        }
+        count++;
+    }
+    items.resize(count);
+    return items;
+}
+
+/**
+* Builds a perfectly balanced subtree from the next count items of first,
+* consuming them in order, and reports its height. The left subtree is
+* built before its root so that items are read exactly once.
+*/
+template<class Key, class Value, class Compare>
+template<typename Tree, typename ForwardIt>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::buildSorted(Tree& tree, ForwardIt& first, size_t count, Node<Key, Value>* parent, int& height)
+{
+    if(count == 0){
+        height = 0;
+        return nullptr;
+    }
+    int leftHeight;
+    int rightHeight;
+    size_t leftCount = (count - 1) / 2;
+    Node<Key, Value>* left = buildSorted(tree, first, leftCount, nullptr, leftHeight);
+    Node<Key, Value>* curr = tree.createNode(parent, first->first, first->second);
+    ++first;
+    Node<Key, Value>* right = buildSorted(tree, first, count - 1 - leftCount, curr, rightHeight);
+    curr->setLeft(left);
+    if(left != nullptr){
+        left->setParent(curr);
+    }
+    curr->setRight(right);
+    tree.buildFix(curr, leftHeight, rightHeight);
+    tree.updateNode(curr);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return curr;
+}
+
+
+/*
+* A remove method to remove a specific key from a Binary Search Tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
+{
+    removeNode(internalFind(key));
+}
+
+/**
+* Removes the item whose key is equivalent to key, if any, without
+* converting key to a Key.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+void BinarySearchTree<Key, Value, Compare>::remove(const K& key)
+{
+    removeNode(internalFind(key));
+}
+
+/**
+* Removes the item at pos, which must not be end(), and returns an
+* iterator to the item after it. The node in hand is unlinked directly,
+* so there is no search.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::erase(iterator pos)
+{
+    iterator next = pos;
+    ++next;
+    return eraseWith(*this, pos, next);
+}
+
+/**
+* Removes the items in [first, last) and returns last.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::erase(iterator first, iterator last)
+{
+    return eraseWith(*this, first, last);
+}
+
+/**
+* Removes every item for which pred(item) is true, in one in-order
+* sweep, and returns how many were removed.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Pred>
+size_t BinarySearchTree<Key, Value, Compare>::erase_if(Pred pred)
+{
+    return eraseIfWith(*this, pred);
+}
+
+/**
+* The range erase shared by every tree. Removing a node never moves
+* another node's item (two-child removals swap nodes, not items), so the
+* successor taken before each removal stays valid, and so does last.
+* Stepping along the range costs O(1) amortized per item, on top of each
+* removal's own rebalancing.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::eraseWith(Tree& tree, iterator first, iterator last)
+{
+    if((first.current_ == tree.getSmallestNode()) && (last.current_ == nullptr)){
+        tree.clear();
+        return last;
+    }
+    Node<Key, Value>* curr = first.current_;
+    while(curr != last.current_){
+        Node<Key, Value>* next = successor(curr);
+        tree.removeNode(curr);
+        curr = next;
+    }
+    return last;
+}
+
+/**
+* The erase_if shared by every tree; see eraseWith.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree, typename Pred>
+size_t BinarySearchTree<Key, Value, Compare>::eraseIfWith(Tree& tree, Pred& pred)
+{
+    size_t removed = 0;
+    Node<Key, Value>* curr = tree.getSmallestNode();
+    while(curr != nullptr){
+        Node<Key, Value>* next = successor(curr);
+        if(pred(static_cast<const std::pair<const Key, Value>&>(curr->getItem()))){
+            tree.removeNode(curr);
+            removed++;
+        }
+        curr = next;
+    }
+    return removed;
+}
+
+/**
+* Unlinks and frees curr, which may be NULL; the rest of remove.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::removeNode(Node<Key, Value>* curr)
+{
+    if((root_ == nullptr) || (curr == nullptr)){
+        return;
     }
+    unlinkEnds(curr);
     Node<Key, Value>* child;
     if(((curr->getLeft()) != nullptr) && ((curr->getRight()) != nullptr)){
         nodeSwap(curr, predecessor(curr));
@@ -523,7 +2056,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     }
     else{
         if((curr->getParent()) == nullptr){
-            root_ = nullptr;
+            setRoot(nullptr);
         }
         else if(((curr->getParent())->getRight()) == curr){
             (curr->getParent())->setRight(nullptr);
@@ -531,11 +2064,12 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         else{
             (curr->getParent())->setLeft(nullptr);
         }
-        delete curr;
+        updatePath(curr->getParent());
+        destroyNode(curr);
         return;
     }
     if((curr->getParent()) == nullptr){
-        root_ = child;
+        setRoot(child);
     }
     else if(((curr->getParent())->getRight()) == curr){
         (curr->getParent())->setRight(child);
@@ -544,13 +2078,14 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         (curr->getParent())->setLeft(child);
     }
     child->setParent(curr->getParent());
-    delete curr;
+    updatePath(curr->getParent());
+    destroyNode(curr);
 }
 
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {
     // TODO
     if(current == nullptr){
@@ -559,7 +2094,7 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     Node<Key, Value>* curr = (current->getLeft());
     Node<Key, Value>* prev = (current->getParent());
     if(curr == nullptr){
-        curr = prev;
+        curr = current;
         while(prev != nullptr){
             if(curr == (prev->getRight())){
                 return prev;
@@ -577,9 +2112,9 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     return prev;
 }
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
 {
     // TODO
     if(current == nullptr){
@@ -588,7 +2123,7 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
     Node<Key, Value>* curr = (current->getRight());
     Node<Key, Value>* prev = (current->getParent());
     if(curr == nullptr){
-        curr = prev;
+        curr = current;
         while(prev != nullptr){
             if(curr == (prev->getLeft())){
                 return prev;
@@ -606,72 +2141,298 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
     return prev;
 }
 
+/**
+* The predecessor of a node with no left child: the nearest ancestor
+* that has curr in its right subtree, or NULL (also for a NULL curr).
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::ancestorPredecessor(Node<Key, Value>* curr)
+{
+    if(curr == nullptr){
+        return nullptr;
+    }
+    Node<Key, Value>* parent = curr->getParent();
+    while((parent != nullptr) && ((parent->getLeft()) == curr)){
+        curr = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
+/**
+* The successor of a node with no right child: the nearest ancestor
+* that has curr in its left subtree, or NULL (also for a NULL curr).
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::ancestorSuccessor(Node<Key, Value>* curr)
+{
+    if(curr == nullptr){
+        return nullptr;
+    }
+    Node<Key, Value>* parent = curr->getParent();
+    while((parent != nullptr) && ((parent->getRight()) == curr)){
+        curr = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
     // TODO
-    clearHelper(root_);
-    root_ = nullptr;
+    clearWith(*this);
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value>* curr){
-    if(curr == nullptr){
-        return;
+/**
+* Empties tree. When its nodes need no destructor their slabs are
+* released as a whole and no node is visited.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree>
+void BinarySearchTree<Key, Value, Compare>::clearWith(Tree& tree)
+{
+#ifdef BST_HEAP_NODES
+    clearHelper(tree, tree.root_);
+#else
+    if(!tree.trivialNodes()){
+        clearHelper(tree, tree.root_);
+    }
+    tree.pool_.release();
+#endif
+    tree.root_ = nullptr;
+    tree.leftmost_ = nullptr;
+    tree.rightmost_ = nullptr;
+}
+
+/**
+* Frees the subtree rooted at curr without recursion: left children are
+* rotated up until the current node has none, then it is deleted and we
+* move on to its right child. Safe on degenerate trees of any depth.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree>
+void BinarySearchTree<Key, Value, Compare>::clearHelper(Tree& tree, Node<Key, Value>* curr){
+    while(curr != nullptr){
+        Node<Key, Value>* left = curr->getLeft();
+        if(left != nullptr){
+            curr->setLeft(left->getRight());
+            left->setRight(curr);
+            curr = left;
+        }
+        else{
+            Node<Key, Value>* right = curr->getRight();
+            tree.destroyNode(curr);
+            curr = right;
+        }
     }
-    clearHelper(curr->getLeft());
-    clearHelper(curr->getRight());
-    delete curr;
 }
 
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
 {
     // TODO
+    return leftmost_;
+}
+
+/**
+* A helper function to find the largest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::getLargestNode() const
+{
+    return rightmost_;
+}
+
+/**
+* The descent every lookup shares: from the root to the bottom of the
+* tree, going left when comp_(key, node key) and right otherwise, with
+* one comparison per level and no early exit on equality. Only the next
+* child depends on the comparison, so for simple keys each step is a
+* conditional move rather than a branch that mispredicts half the time.
+* Returns the last node visited (NULL for an empty tree), which is where
+* a new leaf for key would hang, and sets wentLeft to the side key falls
+* on. The largest key not greater than key is then that node if the
+* search went right and its predecessor if it went left.
+*
+* Callers step from that node with ancestorPredecessor/ancestorSuccessor
+* rather than predecessor/successor: the child they would test again is
+* known to be NULL, and reusing its load keeps the compiler from turning
+* the descent back into branches.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalDescend(const K& key, bool& wentLeft) const
+{
     Node<Key, Value>* curr = root_;
-    while((curr != nullptr) && ((curr->getLeft()) != nullptr)){
-        curr = (curr->getLeft());
+    Node<Key, Value>* last = nullptr;
+    bool left = false;
+    while(curr != nullptr){
+        last = curr;
+        left = comp_(key, curr->getKey());
+        curr = left ? curr->getLeft() : curr->getRight();
     }
-    return curr;
+    wentLeft = left;
+    return last;
 }
 
 /**
 * Helper function to find a node with given key, k and
 * return a pointer to it or NULL if no item with that key
-* exists
+* exists. Only the largest key not greater than key can be equal
+* to it, which takes one more comparison after the descent.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const K& key) const
 {
     // TODO
+    Node<Key, Value>* parent;
+    return internalFindParent(key, parent);
+}
+
+/**
+* Single-descent lookup used by insert. Returns the node holding key, or
+* NULL with parent set to the node a new leaf for key would hang from
+* (NULL for an empty tree). For scalar keys in their natural order the
+* equality test costs nothing next to the ordering test (both are one
+* machine compare), so the search stops as soon as it meets key. Only a
+* Key can be tested that way, so other lookup types take the general
+* path.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindParent(const K& key, Node<Key, Value>*& parent) const
+{
+    return internalFindParent(key, parent, std::integral_constant<bool,
+        ScalarCompare<Key, Compare>::value && std::is_same<K, Key>::value>());
+}
+
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindParent(const K& key, Node<Key, Value>*& parent, std::true_type scalar) const
+{
     Node<Key, Value>* curr = root_;
+    parent = nullptr;
+    while((curr != nullptr) && !(key == (curr->getKey()))){
+        parent = curr;
+        curr = comp_(key, curr->getKey()) ? curr->getLeft() : curr->getRight();
+    }
+    return curr;
+}
+
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindParent(const K& key, Node<Key, Value>*& parent, std::false_type scalar) const
+{
+    bool wentLeft;
+    parent = internalDescend(key, wentLeft);
+    Node<Key, Value>* floor = wentLeft ? ancestorPredecessor(parent) : parent;
+    if((floor == nullptr) || comp_(floor->getKey(), key)){
+        return nullptr;
+    }
+    return floor;
+}
+
+/**
+* Returns the node with the smallest key not less than key, or NULL.
+* The descent is internalDescend's with the test flipped, going left
+* whenever the node is not less than key, so with a transparent Compare
+* it lands before every key equivalent to key, not just one of them.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalLowerBound(const K& key) const
+{
+    Node<Key, Value>* curr = root_;
+    Node<Key, Value>* last = nullptr;
+    bool left = false;
     while(curr != nullptr){
-        if(key == (curr->getKey())){
-            break;
-        }
-        else if(key < (curr->getKey())){
-            curr = curr->getLeft();
+        last = curr;
+        left = !comp_(curr->getKey(), key);
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    return left ? last : ancestorSuccessor(last);
+}
+
+/**
+* Returns the node with the smallest key greater than key, or NULL: the
+* last node of the descent if key falls to its left, else its successor.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalUpperBound(const K& key) const
+{
+    bool wentLeft;
+    Node<Key, Value>* last = internalDescend(key, wentLeft);
+    return wentLeft ? last : ancestorSuccessor(last);
+}
+
+/**
+* Like internalFindParent, but first checks whether key falls between hint
+* and its in-order neighbour (hint == NULL stands for end()). In that case
+* the leaf position is read off the two nodes directly: the new key goes
+* into whichever of them has the free child slot.
+*
+* Past either end the neighbour is known without a walk: a key above the
+* largest node hangs right of rightmost_, and one below the smallest
+* hangs left of leftmost_. So appending in order, with end() or the last
+* insert as the hint, is O(1) plus the retrace.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::hintFindParent(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent) const
+{
+    parent = nullptr;
+    if(root_ == nullptr){
+        return nullptr;
+    }
+    if(((hint == nullptr) || (hint == rightmost_)) && comp_(rightmost_->getKey(), key)){
+        parent = rightmost_;
+        return nullptr;
+    }
+    if((hint == leftmost_) && comp_(key, leftmost_->getKey())){
+        parent = leftmost_;
+        return nullptr;
+    }
+    if(hint == nullptr){
+        return internalFindParent(key, parent);
+    }
+    if(comp_(key, hint->getKey())){
+        Node<Key, Value>* prev = predecessor(hint);
+        if((prev == nullptr) || comp_(prev->getKey(), key)){
+            parent = ((hint->getLeft()) == nullptr) ? hint : prev;
+            return nullptr;
         }
-        else{
-            curr = curr->getRight();
+    }
+    else if(comp_(hint->getKey(), key)){
+        Node<Key, Value>* next = successor(hint);
+        if((next == nullptr) || comp_(key, next->getKey())){
+            parent = ((hint->getRight()) == nullptr) ? hint : next;
+            return nullptr;
         }
     }
-    return curr;
+    else{
+        return hint;
+    }
+    return internalFindParent(key, parent);
 }
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
     // TODO
     if(root_ == nullptr){
@@ -685,8 +2446,8 @@ bool BinarySearchTree<Key, Value>::isBalanced() const
 	return (isBalanced(root_->getLeft()) && isBalanced(root_->getRight())); 
 }
 
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced(Node<Key, Value>* curr) const{
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced(Node<Key, Value>* curr) const{
     if(curr == nullptr){
 		return true;
 	}
@@ -699,8 +2460,8 @@ bool BinarySearchTree<Key, Value>::isBalanced(Node<Key, Value>* curr) const{
 }
 
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key,Value>::subheight(Node<Key,Value>* root) const{
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::subheight(Node<Key,Value>* root) const{
     if(root != nullptr){
         return (subheight(root->getLeft()) + subheight(root->getRight()) + 1);
     }
@@ -708,8 +2469,19 @@ int BinarySearchTree<Key,Value>::subheight(Node<Key,Value>* root) const{
 }
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+{
+    nodeSwapWith(*this, n1, n2);
+}
+
+/**
+* The body of nodeSwap, shared by every tree. Child links and the root are
+* written through tree's publishLeft, publishRight and setRoot hooks.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree>
+void BinarySearchTree<Key, Value, Compare>::nodeSwapWith(Tree& tree, Node<Key, Value>* n1, Node<Key, Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -732,37 +2504,37 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     n2->setParent(temp);
 
     temp = n1->getLeft();
-    n1->setLeft(n2->getLeft());
-    n2->setLeft(temp);
+    tree.publishLeft(n1, n2->getLeft());
+    tree.publishLeft(n2, temp);
 
     temp = n1->getRight();
-    n1->setRight(n2->getRight());
-    n2->setRight(temp);
+    tree.publishRight(n1, n2->getRight());
+    tree.publishRight(n2, temp);
 
     if( (n1r != NULL && n1r == n2) ) {
-        n2->setRight(n1);
+        tree.publishRight(n2, n1);
         n1->setParent(n2);
     }
     else if( n2r != NULL && n2r == n1) {
-        n1->setRight(n2);
+        tree.publishRight(n1, n2);
         n2->setParent(n1);
 
     }
     else if( n1lt != NULL && n1lt == n2) {
-        n2->setLeft(n1);
+        tree.publishLeft(n2, n1);
         n1->setParent(n2);
 
     }
     else if( n2lt != NULL && n2lt == n1) {
-        n1->setLeft(n2);
+        tree.publishLeft(n1, n2);
         n2->setParent(n1);
 
     }
 
 
     if(n1p != NULL && n1p != n2) {
-        if(n1isLeft) n1p->setLeft(n2);
-        else n1p->setRight(n2);
+        if(n1isLeft) tree.publishLeft(n1p, n2);
+        else tree.publishRight(n1p, n2);
     }
     if(n1r != NULL && n1r != n2) {
         n1r->setParent(n2);
@@ -772,8 +2544,8 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     }
 
     if(n2p != NULL && n2p != n1) {
-        if(n2isLeft) n2p->setLeft(n1);
-        else n2p->setRight(n1);
+        if(n2isLeft) tree.publishLeft(n2p, n1);
+        else tree.publishRight(n2p, n1);
     }
     if(n2r != NULL && n2r != n1) {
         n2r->setParent(n1);
@@ -783,11 +2555,11 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     }
 
 
-    if(this->root_ == n1) {
-        this->root_ = n2;
+    if(tree.root_ == n1) {
+        tree.setRoot(n2);
     }
-    else if(this->root_ == n2) {
-        this->root_ = n1;
+    else if(tree.root_ == n2) {
+        tree.setRoot(n1);
     }
 
 }
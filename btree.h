@@ -0,0 +1,1175 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "nodepool.h"
+#include "simdsearch.h"
+
+/**
+* The part shared by both kinds of BTree node: the keys and their count.
+* The keys come first so that the block the search kernels read starts
+* the node, and there are ORDER of them, a whole number of kernel blocks
+* (one cache line for integral keys) and at least 8.
+*
+* Every slot is constructed: the slots from count_ on hold copies of the
+* last key, so the kernels can rank a key against whole blocks; see
+* BTree::rankLower.
+*/
+template <typename Key, typename Value>
+class BTreeNode
+{
+public:
+    static const size_t BLOCK = BlockRank<Key>::WIDTH;
+    static const size_t ORDER = (8 + BLOCK - 1) / BLOCK * BLOCK;
+
+    // Constructor/destructor.
+    BTreeNode(bool leaf, const Key& fill);
+    ~BTreeNode();
+
+    size_t getCount() const;
+    bool isLeaf() const;
+    const Key& getKey(size_t i) const;
+
+protected:
+    // The tree shifts keys and children around directly.
+    template<typename K, typename V> friend class BTree;
+
+    Key* keys();
+    const Key* keys() const;
+
+    typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keys_[ORDER];
+    uint32_t count_;
+    bool leaf_;
+};
+
+/**
+* A leaf: up to ORDER items in key order, their keys again in the key
+* block, and links to the neighbouring leaves for iteration.
+*/
+template <typename Key, typename Value>
+class BTreeLeaf : public BTreeNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    explicit BTreeLeaf(const Key& fill);
+    ~BTreeLeaf();
+
+    std::pair<const Key, Value>& getItem(size_t i);
+    BTreeLeaf<Key, Value>* getNext() const;
+    BTreeLeaf<Key, Value>* getPrev() const;
+
+protected:
+    template<typename K, typename V> friend class BTree;
+    typedef std::pair<const Key, Value> Item;
+
+    Item* items();
+
+    typename std::aligned_storage<sizeof(Item), alignof(Item)>::type items_[BTreeNode<Key, Value>::ORDER];
+    BTreeLeaf<Key, Value>* prev_;
+    BTreeLeaf<Key, Value>* next_;
+};
+
+/**
+* An inner node: count_ separator keys and count_ + 1 children. Every key
+* under children_[i] is less than key i and not less than key i - 1.
+*/
+template <typename Key, typename Value>
+class BTreeInner : public BTreeNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    explicit BTreeInner(const Key& fill);
+    ~BTreeInner();
+
+    BTreeNode<Key, Value>* getChild(size_t i) const;
+
+protected:
+    template<typename K, typename V> friend class BTree;
+
+    BTreeNode<Key, Value>* children_[BTreeNode<Key, Value>::ORDER + 1];
+};
+
+template<typename Key, typename Value>
+const size_t BTreeNode<Key, Value>::BLOCK;
+
+template<typename Key, typename Value>
+const size_t BTreeNode<Key, Value>::ORDER;
+
+/*
+  --------------------------------------------------------------
+  Begin implementations for the BTreeNode, BTreeLeaf and
+  BTreeInner classes.
+  --------------------------------------------------------------
+*/
+
+/**
+* An explicit constructor; the node starts empty, with every key slot a
+* copy of fill.
+*/
+template<class Key, class Value>
+BTreeNode<Key, Value>::BTreeNode(bool leaf, const Key& fill) :
+    count_(0),
+    leaf_(leaf)
+{
+    for(size_t i = 0; i < ORDER; i++){
+        new (keys() + i) Key(fill);
+    }
+}
+
+template<class Key, class Value>
+BTreeNode<Key, Value>::~BTreeNode()
+{
+    for(size_t i = 0; i < ORDER; i++){
+        keys()[i].~Key();
+    }
+}
+
+template<class Key, class Value>
+size_t BTreeNode<Key, Value>::getCount() const
+{
+    return count_;
+}
+
+template<class Key, class Value>
+bool BTreeNode<Key, Value>::isLeaf() const
+{
+    return leaf_;
+}
+
+template<class Key, class Value>
+const Key& BTreeNode<Key, Value>::getKey(size_t i) const
+{
+    return keys()[i];
+}
+
+template<class Key, class Value>
+Key* BTreeNode<Key, Value>::keys()
+{
+    return reinterpret_cast<Key*>(keys_);
+}
+
+template<class Key, class Value>
+const Key* BTreeNode<Key, Value>::keys() const
+{
+    return reinterpret_cast<const Key*>(keys_);
+}
+
+template<class Key, class Value>
+BTreeLeaf<Key, Value>::BTreeLeaf(const Key& fill) :
+    BTreeNode<Key, Value>(true, fill),
+    prev_(nullptr),
+    next_(nullptr)
+{
+
+}
+
+/**
+* Destroys the items still in the leaf.
+*/
+template<class Key, class Value>
+BTreeLeaf<Key, Value>::~BTreeLeaf()
+{
+    for(size_t i = 0; i < this->count_; i++){
+        items()[i].~Item();
+    }
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& BTreeLeaf<Key, Value>::getItem(size_t i)
+{
+    return items()[i];
+}
+
+template<class Key, class Value>
+BTreeLeaf<Key, Value>* BTreeLeaf<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+template<class Key, class Value>
+BTreeLeaf<Key, Value>* BTreeLeaf<Key, Value>::getPrev() const
+{
+    return prev_;
+}
+
+template<class Key, class Value>
+typename BTreeLeaf<Key, Value>::Item* BTreeLeaf<Key, Value>::items()
+{
+    return reinterpret_cast<Item*>(items_);
+}
+
+template<class Key, class Value>
+BTreeInner<Key, Value>::BTreeInner(const Key& fill) :
+    BTreeNode<Key, Value>(false, fill)
+{
+
+}
+
+/**
+* A destructor which does nothing; the tree frees the children.
+*/
+template<class Key, class Value>
+BTreeInner<Key, Value>::~BTreeInner()
+{
+
+}
+
+template<class Key, class Value>
+BTreeNode<Key, Value>* BTreeInner<Key, Value>::getChild(size_t i) const
+{
+    return children_[i];
+}
+
+/*
+  ------------------------------------------------------------
+  End implementations for the BTreeNode, BTreeLeaf and
+  BTreeInner classes.
+  ------------------------------------------------------------
+*/
+
+/**
+* A B+tree map with the interface of BinarySearchTree, for use where an
+* AVLTree would otherwise hold many items.
+*
+* A binary tree of n items takes about log2(n) dependent cache misses per
+* lookup; here every node holds up to ORDER keys in one block, ranked
+* against the search key with one SIMD kernel call (see simdsearch.h),
+* so a lookup takes about log(n) / log(ORDER / 2) misses. Items live only
+* in the leaves, which are linked in key order.
+*
+* Inserts split full nodes on the way down, so no node is revisited.
+* Removes fix nodes that fell below MIN_KEYS on the way back up, by
+* borrowing from a sibling or merging with one. Nodes come from one slab
+* pool per node kind, cache line aligned. The tree can be moved and
+* swapped in O(1), but not copied.
+*/
+template <typename Key, typename Value>
+class BTree
+{
+protected:
+    typedef BTreeNode<Key, Value> BNode;
+    typedef BTreeLeaf<Key, Value> Leaf;
+    typedef BTreeInner<Key, Value> Inner;
+    typedef std::pair<const Key, Value> Item;
+    typedef typename BlockRank<Key>::Function RankFunction;
+
+public:
+    static const size_t ORDER = BNode::ORDER;
+    static const size_t MIN_KEYS = ORDER / 2 - 1;
+
+    BTree();
+    BTree(const BTree<Key, Value>& other) = delete;
+    BTree(BTree<Key, Value>&& other);
+    ~BTree();
+    BTree<Key, Value>& operator=(BTree<Key, Value> other);
+    void swap(BTree<Key, Value>& other);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+
+    /**
+    * An iterator over the tree in key order: a leaf and a slot in it.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BTree<Key, Value>;
+        iterator(Leaf* leaf, size_t index);
+        Leaf* leaf_;
+        size_t index_;
+    };
+
+    /**
+    * A [first, last) pair of iterators that can be walked with a
+    * range-based for loop; returned by range().
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    static const size_t CACHE_LINE = 64;
+
+    size_t rankLower(const BNode* curr, const Key& key) const;
+    size_t rankUpper(const BNode* curr, const Key& key) const;
+    Leaf* findLeaf(const Key& key) const;
+    iterator leafPosition(Leaf* leaf, size_t index) const;
+    int subheight(const BNode* curr) const;
+
+    Leaf* createLeaf(const Key& fill);
+    Inner* createInner(const Key& fill);
+    void destroyNode(BNode* curr);
+    void clearHelper(BNode* curr);
+
+    static void pad(BNode* curr);
+    template<typename Arg>
+    static void leafInsert(Leaf* leaf, size_t i, Arg&& item);
+    static void leafErase(Leaf* leaf, size_t i);
+    static void leafMove(Leaf* from, size_t i, Leaf* to);
+    static void innerInsert(Inner* inner, size_t i, const Key& key, BNode* right);
+    static void innerErase(Inner* inner, size_t i);
+
+    void splitChild(Inner* parent, size_t i);
+    bool removeFrom(BNode* curr, const Key& key);
+    void refill(Inner* parent, size_t i);
+    void merge(Inner* parent, size_t i);
+
+protected:
+    BNode* root_;
+    size_t size_;
+    RankFunction lower_;
+    RankFunction upper_;
+    NodePool leafPool_;
+    NodePool innerPool_;
+};
+
+template<class Key, class Value>
+const size_t BTree<Key, Value>::ORDER;
+
+template<class Key, class Value>
+const size_t BTree<Key, Value>::MIN_KEYS;
+
+template<class Key, class Value>
+const size_t BTree<Key, Value>::CACHE_LINE;
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the BTree::iterator class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value>
+BTree<Key, Value>::iterator::iterator(Leaf* leaf, size_t index) :
+    leaf_(leaf),
+    index_(index)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value>
+BTree<Key, Value>::iterator::iterator() :
+    leaf_(nullptr),
+    index_(0)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& BTree<Key, Value>::iterator::operator*() const
+{
+    return leaf_->getItem(index_);
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* BTree<Key, Value>::iterator::operator->() const
+{
+    return &(leaf_->getItem(index_));
+}
+
+/**
+* Two iterators are equal if they are at the same slot of the same leaf.
+*/
+template<class Key, class Value>
+bool BTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return (leaf_ == rhs.leaf_) && (index_ == rhs.index_);
+}
+
+template<class Key, class Value>
+bool BTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps to the next slot, moving on to the next leaf at the end of this
+* one.
+*/
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator& BTree<Key, Value>::iterator::operator++()
+{
+    index_++;
+    if(index_ == leaf_->getCount()){
+        leaf_ = leaf_->getNext();
+        index_ = 0;
+    }
+    return (*this);
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the BTree::iterator class.
+  ----------------------------------------------------
+*/
+
+template<class Key, class Value>
+BTree<Key, Value>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::iterator_range::end() const
+{
+    return last_;
+}
+
+/**
+* Returns true if the range holds no items.
+*/
+template<class Key, class Value>
+bool BTree<Key, Value>::iterator_range::empty() const
+{
+    return first_ == last_;
+}
+
+/*
+  ---------------------------------------------
+  Begin implementations for the BTree class.
+  ---------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree, searching with the fastest
+* kernel the CPU has.
+*/
+template<class Key, class Value>
+BTree<Key, Value>::BTree() :
+    root_(nullptr),
+    size_(0),
+    lower_(BlockRank<Key>::lower(bestSearchKernel())),
+    upper_(BlockRank<Key>::upper(bestSearchKernel()))
+{
+
+}
+
+/**
+* Takes over other's nodes and their storage in O(1), leaving other empty.
+*/
+template<class Key, class Value>
+BTree<Key, Value>::BTree(BTree<Key, Value>&& other) :
+    root_(other.root_),
+    size_(other.size_),
+    lower_(other.lower_),
+    upper_(other.upper_)
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+    leafPool_.swap(other.leafPool_);
+    innerPool_.swap(other.innerPool_);
+}
+
+template<class Key, class Value>
+BTree<Key, Value>::~BTree()
+{
+    clear();
+}
+
+/**
+* Move assignment: other was built by the move constructor, so taking its
+* contents is a swap, and the old nodes go away with other.
+*/
+template<class Key, class Value>
+BTree<Key, Value>& BTree<Key, Value>::operator=(BTree<Key, Value> other)
+{
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1). Iterators stay valid and
+* now refer into the other tree.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::swap(BTree<Key, Value>& other)
+{
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+    std::swap(lower_, other.lower_);
+    std::swap(upper_, other.upper_);
+    leafPool_.swap(other.leafPool_);
+    innerPool_.swap(other.innerPool_);
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already in the
+* tree. A full root is split first, growing the tree by one level, and
+* each full child on the way down is split before stepping into it, so
+* the leaf reached has room.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if(root_ == nullptr){
+        Leaf* leaf = createLeaf(key);
+        leafInsert(leaf, 0, keyValuePair);
+        root_ = leaf;
+        size_++;
+        return;
+    }
+    if(root_->count_ == ORDER){
+        Inner* root = createInner(root_->keys()[0]);
+        root->children_[0] = root_;
+        root_ = root;
+        splitChild(root, 0);
+    }
+    BNode* curr = root_;
+    while(!curr->leaf_){
+        Inner* inner = static_cast<Inner*>(curr);
+        size_t i = rankUpper(inner, key);
+        if(inner->children_[i]->count_ == ORDER){
+            splitChild(inner, i);
+            i += !(key < inner->keys()[i]);
+        }
+        curr = inner->children_[i];
+    }
+    Leaf* leaf = static_cast<Leaf*>(curr);
+    size_t i = rankLower(leaf, key);
+    if((i < leaf->count_) && !(key < leaf->keys()[i])){
+        leaf->items()[i].second = keyValuePair.second;
+        return;
+    }
+    leafInsert(leaf, i, keyValuePair);
+    size_++;
+}
+
+/**
+* Removes the item with the given key, if any. A root left without keys
+* is replaced by its only child, shrinking the tree by one level.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::remove(const Key& key)
+{
+    if((root_ == nullptr) || !removeFrom(root_, key)){
+        return;
+    }
+    size_--;
+    if(root_->count_ == 0){
+        BNode* old = root_;
+        root_ = old->leaf_ ? nullptr : static_cast<Inner*>(old)->children_[0];
+        destroyNode(old);
+    }
+}
+
+/**
+* Removes every item. When the items need no destructor the slabs are
+* released as a whole, as BinarySearchTree::clear does.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::clear()
+{
+#ifdef BST_HEAP_NODES
+    clearHelper(root_);
+#else
+    if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value){
+        clearHelper(root_);
+    }
+    leafPool_.release();
+    innerPool_.release();
+#endif
+    root_ = nullptr;
+    size_ = 0;
+}
+
+template<class Key, class Value>
+void BTree<Key, Value>::clearHelper(BNode* curr)
+{
+    if(curr == nullptr){
+        return;
+    }
+    if(!curr->leaf_){
+        Inner* inner = static_cast<Inner*>(curr);
+        for(size_t i = 0; i <= inner->count_; i++){
+            clearHelper(inner->children_[i]);
+        }
+    }
+    destroyNode(curr);
+}
+
+/**
+* Checks the tree is a valid B-tree: every leaf at the same depth and
+* every node but the root at least half full. Always true unless the
+* tree was corrupted.
+*/
+template<class Key, class Value>
+bool BTree<Key, Value>::isBalanced() const
+{
+    return (root_ == nullptr) || (subheight(root_) != -1);
+}
+
+/**
+* The height of the subtree at curr, or -1 if its leaves are not all at
+* the same depth or one of its nodes is under MIN_KEYS.
+*/
+template<class Key, class Value>
+int BTree<Key, Value>::subheight(const BNode* curr) const
+{
+    if((curr != root_) && (curr->count_ < MIN_KEYS)){
+        return -1;
+    }
+    if(curr->leaf_){
+        return 1;
+    }
+    const Inner* inner = static_cast<const Inner*>(curr);
+    int height = subheight(inner->children_[0]);
+    for(size_t i = 1; (height != -1) && (i <= inner->count_); i++){
+        if(subheight(inner->children_[i]) != height){
+            height = -1;
+        }
+    }
+    return (height == -1) ? -1 : height + 1;
+}
+
+template<class Key, class Value>
+bool BTree<Key, Value>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, class Value>
+size_t BTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+* Starts at the first slot of the leftmost leaf.
+*/
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::begin() const
+{
+    if(root_ == nullptr){
+        return end();
+    }
+    BNode* curr = root_;
+    while(!curr->leaf_){
+        curr = static_cast<Inner*>(curr)->children_[0];
+    }
+    return iterator(static_cast<Leaf*>(curr), 0);
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::end() const
+{
+    return iterator(nullptr, 0);
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::find(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if(leaf == nullptr){
+        return end();
+    }
+    size_t i = rankLower(leaf, key);
+    if((i == leaf->count_) || (key < leaf->keys()[i])){
+        return end();
+    }
+    return iterator(leaf, i);
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::lower_bound(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if(leaf == nullptr){
+        return end();
+    }
+    return leafPosition(leaf, rankLower(leaf, key));
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::upper_bound(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if(leaf == nullptr){
+        return end();
+    }
+    return leafPosition(leaf, rankUpper(leaf, key));
+}
+
+template<class Key, class Value>
+std::pair<typename BTree<Key, Value>::iterator, typename BTree<Key, Value>::iterator>
+BTree<Key, Value>::equal_range(const Key& key) const
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if((first != end()) && !(key < first->first)){
+        ++last;
+    }
+    return std::make_pair(first, last);
+}
+
+/**
+* Returns the items with keys in [lo, hi), as BinarySearchTree::range.
+*/
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator_range BTree<Key, Value>::range(const Key& lo, const Key& hi) const
+{
+    if(!(lo < hi)){
+        return iterator_range(end(), end());
+    }
+    return iterator_range(lower_bound(lo), lower_bound(hi));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value& BTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+Value const & BTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* The number of keys of curr less than key, from one kernel call per
+* block. The padding slots copy the last key, so they only count when
+* every real key does, and capping at the count removes them.
+*/
+template<class Key, class Value>
+size_t BTree<Key, Value>::rankLower(const BNode* curr, const Key& key) const
+{
+    size_t rank = 0;
+    for(size_t b = 0; b < ORDER; b += BNode::BLOCK){
+        rank += lower_(curr->keys() + b, key);
+    }
+    return std::min<size_t>(rank, curr->count_);
+}
+
+/**
+* As rankLower, for the keys not greater than key. For an inner node this
+* is the index of the child whose range holds key.
+*/
+template<class Key, class Value>
+size_t BTree<Key, Value>::rankUpper(const BNode* curr, const Key& key) const
+{
+    size_t rank = 0;
+    for(size_t b = 0; b < ORDER; b += BNode::BLOCK){
+        rank += upper_(curr->keys() + b, key);
+    }
+    return std::min<size_t>(rank, curr->count_);
+}
+
+/**
+* The leaf whose range holds key, or NULL if the tree is empty.
+*/
+template<class Key, class Value>
+typename BTree<Key, Value>::Leaf* BTree<Key, Value>::findLeaf(const Key& key) const
+{
+    BNode* curr = root_;
+    if(curr == nullptr){
+        return nullptr;
+    }
+    while(!curr->leaf_){
+        curr = static_cast<Inner*>(curr)->children_[rankUpper(curr, key)];
+    }
+    return static_cast<Leaf*>(curr);
+}
+
+/**
+* An iterator at slot index of leaf, where index may be one past the
+* leaf's last item; the next leaf then holds the item wanted.
+*/
+template<class Key, class Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::leafPosition(Leaf* leaf, size_t index) const
+{
+    if(index == leaf->count_){
+        return iterator(leaf->next_, 0);
+    }
+    return iterator(leaf, index);
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::Leaf* BTree<Key, Value>::createLeaf(const Key& fill)
+{
+#ifdef BST_HEAP_NODES
+    void* curr = ::operator new(sizeof(Leaf));
+#else
+    void* curr = leafPool_.allocate(sizeof(Leaf), std::max(alignof(Leaf), CACHE_LINE));
+#endif
+    return new (curr) Leaf(fill);
+}
+
+template<class Key, class Value>
+typename BTree<Key, Value>::Inner* BTree<Key, Value>::createInner(const Key& fill)
+{
+#ifdef BST_HEAP_NODES
+    void* curr = ::operator new(sizeof(Inner));
+#else
+    void* curr = innerPool_.allocate(sizeof(Inner), std::max(alignof(Inner), CACHE_LINE));
+#endif
+    return new (curr) Inner(fill);
+}
+
+/**
+* Destroys a node of either kind, with the items still in it; an inner
+* node's children are left alone.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::destroyNode(BNode* curr)
+{
+    if(curr->leaf_){
+        static_cast<Leaf*>(curr)->~Leaf();
+#ifdef BST_HEAP_NODES
+        ::operator delete(curr);
+#else
+        leafPool_.deallocate(curr);
+#endif
+    }
+    else{
+        static_cast<Inner*>(curr)->~Inner();
+#ifdef BST_HEAP_NODES
+        ::operator delete(curr);
+#else
+        innerPool_.deallocate(curr);
+#endif
+    }
+}
+
+/**
+* Copies the last key of curr into its padding slots.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::pad(BNode* curr)
+{
+    if(curr->count_ == 0){
+        return;
+    }
+    Key* keys = curr->keys();
+    for(size_t i = curr->count_; i < ORDER; i++){
+        keys[i] = keys[curr->count_ - 1];
+    }
+}
+
+/**
+* Puts item into slot i of a leaf that is not full, shifting the items
+* after it up one slot.
+*/
+template<class Key, class Value>
+template<typename Arg>
+void BTree<Key, Value>::leafInsert(Leaf* leaf, size_t i, Arg&& item)
+{
+    Item* items = leaf->items();
+    Key* keys = leaf->keys();
+    for(size_t j = leaf->count_; j > i; j--){
+        new (items + j) Item(std::move(items[j - 1]));
+        items[j - 1].~Item();
+        keys[j] = keys[j - 1];
+    }
+    new (items + i) Item(std::forward<Arg>(item));
+    keys[i] = items[i].first;
+    leaf->count_++;
+    pad(leaf);
+}
+
+/**
+* Destroys the item in slot i of a leaf, shifting the items after it down
+* one slot.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::leafErase(Leaf* leaf, size_t i)
+{
+    Item* items = leaf->items();
+    Key* keys = leaf->keys();
+    items[i].~Item();
+    for(size_t j = i + 1; j < leaf->count_; j++){
+        new (items + j - 1) Item(std::move(items[j]));
+        items[j].~Item();
+        keys[j - 1] = keys[j];
+    }
+    leaf->count_--;
+    pad(leaf);
+}
+
+/**
+* Moves the items of from, starting at slot i, to the end of to.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::leafMove(Leaf* from, size_t i, Leaf* to)
+{
+    Item* items = from->items();
+    for(size_t j = i; j < from->count_; j++){
+        new (to->items() + to->count_) Item(std::move(items[j]));
+        items[j].~Item();
+        to->keys()[to->count_] = from->keys()[j];
+        to->count_++;
+    }
+    from->count_ = i;
+    pad(from);
+    pad(to);
+}
+
+/**
+* Puts key into slot i of an inner node that is not full, with right as
+* the child after it.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::innerInsert(Inner* inner, size_t i, const Key& key, BNode* right)
+{
+    Key* keys = inner->keys();
+    for(size_t j = inner->count_; j > i; j--){
+        keys[j] = keys[j - 1];
+        inner->children_[j + 1] = inner->children_[j];
+    }
+    keys[i] = key;
+    inner->children_[i + 1] = right;
+    inner->count_++;
+    pad(inner);
+}
+
+/**
+* Takes key i and the child after it out of an inner node.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::innerErase(Inner* inner, size_t i)
+{
+    Key* keys = inner->keys();
+    for(size_t j = i + 1; j < inner->count_; j++){
+        keys[j - 1] = keys[j];
+        inner->children_[j] = inner->children_[j + 1];
+    }
+    inner->count_--;
+    pad(inner);
+}
+
+/**
+* Splits the full child i of parent in two. A leaf gives its upper half
+* to a new right sibling whose first key becomes the separator; an inner
+* node moves its middle key up into the parent instead.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::splitChild(Inner* parent, size_t i)
+{
+    const size_t half = ORDER / 2;
+    if(parent->children_[i]->leaf_){
+        Leaf* left = static_cast<Leaf*>(parent->children_[i]);
+        Leaf* right = createLeaf(left->keys()[half]);
+        leafMove(left, half, right);
+        right->next_ = left->next_;
+        right->prev_ = left;
+        if(left->next_ != nullptr){
+            left->next_->prev_ = right;
+        }
+        left->next_ = right;
+        innerInsert(parent, i, right->keys()[0], right);
+    }
+    else{
+        Inner* left = static_cast<Inner*>(parent->children_[i]);
+        Inner* right = createInner(left->keys()[half]);
+        for(size_t j = half + 1; j < ORDER; j++){
+            right->keys()[j - half - 1] = left->keys()[j];
+        }
+        for(size_t j = half + 1; j <= ORDER; j++){
+            right->children_[j - half - 1] = left->children_[j];
+        }
+        right->count_ = ORDER - half - 1;
+        left->count_ = half;
+        pad(right);
+        innerInsert(parent, i, left->keys()[half], right);
+        pad(left);
+    }
+}
+
+/**
+* Removes key from the subtree at curr, refilling the child it came out
+* of if that fell under MIN_KEYS. Returns false if the key was not there.
+* Separators are left alone: one whose key was removed still bounds its
+* children correctly.
+*/
+template<class Key, class Value>
+bool BTree<Key, Value>::removeFrom(BNode* curr, const Key& key)
+{
+    if(curr->leaf_){
+        Leaf* leaf = static_cast<Leaf*>(curr);
+        size_t i = rankLower(leaf, key);
+        if((i == leaf->count_) || (key < leaf->keys()[i])){
+            return false;
+        }
+        leafErase(leaf, i);
+        return true;
+    }
+    Inner* inner = static_cast<Inner*>(curr);
+    size_t i = rankUpper(inner, key);
+    if(!removeFrom(inner->children_[i], key)){
+        return false;
+    }
+    if(inner->children_[i]->count_ < MIN_KEYS){
+        refill(inner, i);
+    }
+    return true;
+}
+
+/**
+* Brings child i of parent, one under MIN_KEYS, back up: takes one key
+* from a sibling that can spare it, through the separator between them,
+* or else merges with a sibling.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::refill(Inner* parent, size_t i)
+{
+    BNode* child = parent->children_[i];
+    if((i > 0) && (parent->children_[i - 1]->count_ > MIN_KEYS)){
+        BNode* left = parent->children_[i - 1];
+        if(child->leaf_){
+            Leaf* from = static_cast<Leaf*>(left);
+            leafInsert(static_cast<Leaf*>(child), 0, std::move(from->items()[from->count_ - 1]));
+            leafErase(from, from->count_ - 1);
+            parent->keys()[i - 1] = child->keys()[0];
+        }
+        else{
+            Inner* to = static_cast<Inner*>(child);
+            Inner* from = static_cast<Inner*>(left);
+            for(size_t j = to->count_; j > 0; j--){
+                to->keys()[j] = to->keys()[j - 1];
+            }
+            for(size_t j = to->count_ + 1; j > 0; j--){
+                to->children_[j] = to->children_[j - 1];
+            }
+            to->keys()[0] = parent->keys()[i - 1];
+            to->children_[0] = from->children_[from->count_];
+            to->count_++;
+            pad(to);
+            parent->keys()[i - 1] = from->keys()[from->count_ - 1];
+            from->count_--;
+            pad(from);
+        }
+        pad(parent);
+    }
+    else if((i < parent->count_) && (parent->children_[i + 1]->count_ > MIN_KEYS)){
+        BNode* right = parent->children_[i + 1];
+        if(child->leaf_){
+            Leaf* from = static_cast<Leaf*>(right);
+            leafInsert(static_cast<Leaf*>(child), child->count_, std::move(from->items()[0]));
+            leafErase(from, 0);
+            parent->keys()[i] = from->keys()[0];
+        }
+        else{
+            Inner* to = static_cast<Inner*>(child);
+            Inner* from = static_cast<Inner*>(right);
+            to->keys()[to->count_] = parent->keys()[i];
+            to->children_[to->count_ + 1] = from->children_[0];
+            to->count_++;
+            pad(to);
+            parent->keys()[i] = from->keys()[0];
+            for(size_t j = 1; j < from->count_; j++){
+                from->keys()[j - 1] = from->keys()[j];
+            }
+            for(size_t j = 1; j <= from->count_; j++){
+                from->children_[j - 1] = from->children_[j];
+            }
+            from->count_--;
+            pad(from);
+        }
+        pad(parent);
+    }
+    else{
+        merge(parent, (i > 0) ? i - 1 : i);
+    }
+}
+
+/**
+* Merges child i + 1 of parent into child i and frees it. Between two
+* inner nodes the separator comes down to join them.
+*/
+template<class Key, class Value>
+void BTree<Key, Value>::merge(Inner* parent, size_t i)
+{
+    BNode* left = parent->children_[i];
+    BNode* right = parent->children_[i + 1];
+    if(left->leaf_){
+        Leaf* to = static_cast<Leaf*>(left);
+        Leaf* from = static_cast<Leaf*>(right);
+        leafMove(from, 0, to);
+        to->next_ = from->next_;
+        if(from->next_ != nullptr){
+            from->next_->prev_ = to;
+        }
+    }
+    else{
+        Inner* to = static_cast<Inner*>(left);
+        Inner* from = static_cast<Inner*>(right);
+        to->keys()[to->count_] = parent->keys()[i];
+        for(size_t j = 0; j < from->count_; j++){
+            to->keys()[to->count_ + 1 + j] = from->keys()[j];
+        }
+        for(size_t j = 0; j <= from->count_; j++){
+            to->children_[to->count_ + 1 + j] = from->children_[j];
+        }
+        to->count_ += from->count_ + 1;
+        from->count_ = 0;
+        pad(to);
+    }
+    destroyNode(right);
+    innerErase(parent, i);
+}
+
+/*
+  -------------------------------------------
+  End implementations for the BTree class.
+  -------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1147 @@
+#ifndef COMPACTAVLBST_H
+#define COMPACTAVLBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/**
+* A node of a CompactAVLTree. The links are 32-bit indices into the tree's
+* node array instead of pointers, and the balance is kept in the low 2 bits
+* of the parent link, so that a node is its item plus 12 bytes. For 64-bit
+* keys and values that is 32 bytes per node, against 48 for an AVLNode.
+*
+* With 2 bits of the parent link taken, indices have 30 bits; NIL (all 30
+* bits set) is the null link.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    static const uint32_t NIL = (uint32_t(1) << 30) - 1;
+
+    // Constructor/destructor.
+    CompactAVLNode(const Key& key, const Value& value, uint32_t parent);
+    ~CompactAVLNode();
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Value& getValue();
+    void setValue(const Value& value);
+
+    uint32_t getParent() const;
+    uint32_t getLeft() const;
+    uint32_t getRight() const;
+    void setParent(uint32_t parent);
+    void setLeft(uint32_t left);
+    void setRight(uint32_t right);
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+
+protected:
+    std::pair<const Key, Value> item_;
+    uint32_t left_;
+    uint32_t right_;
+    uint32_t parentBalance_;   // parent index << 2 | (balance + 1)
+};
+
+template<class Key, class Value>
+const uint32_t CompactAVLNode<Key, Value>::NIL;
+
+/*
+  --------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  --------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node is a leaf with balance 0.
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value, uint32_t parent) :
+    item_(key, value),
+    left_(NIL),
+    right_(NIL),
+    parentBalance_((parent << 2) | 1)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::~CompactAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const Value& CompactAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+Value& CompactAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getParent() const
+{
+    return parentBalance_ >> 2;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+/**
+* Replaces the parent link and keeps the balance bits.
+*/
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setParent(uint32_t parent)
+{
+    parentBalance_ = (parent << 2) | (parentBalance_ & 3);
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setLeft(uint32_t left)
+{
+    left_ = left;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setRight(uint32_t right)
+{
+    right_ = right;
+}
+
+/**
+* A getter for the balance of a CompactAVLNode.
+*/
+template<class Key, class Value>
+int8_t CompactAVLNode<Key, Value>::getBalance() const
+{
+    return int8_t(parentBalance_ & 3) - 1;
+}
+
+/**
+* A setter for the balance of a CompactAVLNode. Only -1, 0 and 1 fit in
+* the 2 bits; rebalancing reads the temporary -2/2 from insertFix and
+* removeFix, which keep it in a local instead.
+*/
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    parentBalance_ = (parentBalance_ & ~uint32_t(3)) | uint32_t(balance + 1);
+}
+
+/**
+* Adds diff to the balance of a CompactAVLNode.
+*/
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    setBalance(getBalance() + diff);
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the CompactAVLNode class.
+  ------------------------------------------------
+*/
+
+/**
+* An AVL tree over CompactAVLNode, for trees of fewer than 2^30 nodes.
+* All nodes live in one array owned by the tree, which doubles when full;
+* removed nodes go on a free list threaded through their slots and are
+* reused by the next insert.
+*
+* The iterator and lookup interface is the same as BinarySearchTree's.
+* Iterators are indices, so they survive the array growing; references
+* to items do not, just as with std::vector.
+*
+* Copies are deep. Moving or swapping hands over the node array in O(1);
+* an iterator stays tied to the tree object it came from, so it follows
+* the nodes only if they come back.
+*/
+template <typename Key, typename Value>
+class CompactAVLTree
+{
+protected:
+    typedef CompactAVLNode<Key, Value> CNode;
+
+public:
+    static const uint32_t NIL = CNode::NIL;
+
+    CompactAVLTree();
+    CompactAVLTree(const CompactAVLTree<Key, Value>& other);
+    CompactAVLTree(CompactAVLTree<Key, Value>&& other);
+    ~CompactAVLTree();
+    CompactAVLTree<Key, Value>& operator=(CompactAVLTree<Key, Value> other);
+    void swap(CompactAVLTree<Key, Value>& other);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+
+    /**
+    * An iterator over the tree in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value>;
+        iterator(const CompactAVLTree<Key, Value>* tree, uint32_t curr);
+        const CompactAVLTree<Key, Value>* tree_;
+        uint32_t current_;
+    };
+
+    /**
+    * A [first, last) pair of iterators that can be walked with a
+    * range-based for loop; returned by range().
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    CNode& node(uint32_t curr) const;
+    uint32_t internalFind(const Key& key) const;
+    uint32_t internalLowerBound(const Key& key) const;
+    uint32_t internalUpperBound(const Key& key) const;
+    uint32_t getSmallestNode() const;
+    uint32_t successor(uint32_t curr) const;
+    uint32_t predecessor(uint32_t curr) const;
+    int subheight(uint32_t curr) const;
+
+    uint32_t createNode(const Key& key, const Value& value, uint32_t parent);
+    void destroyNode(uint32_t curr);
+    void grow();
+    void clearHelper(uint32_t curr);
+
+    void insertFix(uint32_t prev, uint32_t curr);
+    void removeFix(uint32_t curr, int8_t diff);
+    uint32_t rebalance(uint32_t prev, int8_t balance);
+    void insertLeft(uint32_t pare);
+    void insertRight(uint32_t pare);
+    void nodeSwap(uint32_t n1, uint32_t n2);
+    void replaceChild(uint32_t parent, uint32_t oldChild, uint32_t newChild);
+
+protected:
+    CNode* nodes_;
+    uint32_t capacity_;
+    uint32_t used_;     // slots ever handed out; [0, used_) is live or free
+    uint32_t free_;     // head of the free list, NIL if empty
+    uint32_t size_;
+    uint32_t root_;
+};
+
+template<class Key, class Value>
+const uint32_t CompactAVLTree<Key, Value>::NIL;
+
+/*
+  ---------------------------------------------------------------
+  Begin implementations for the CompactAVLTree::iterator class.
+  ---------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::iterator::iterator(const CompactAVLTree<Key, Value>* tree, uint32_t curr) :
+    tree_(tree),
+    current_(curr)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::iterator::iterator() :
+    tree_(nullptr),
+    current_(NIL)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& CompactAVLTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->node(current_).getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* CompactAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->node(current_).getItem());
+}
+
+/**
+* Two iterators are equal if they are at the same node; every end()
+* iterator is equal to every other one.
+*/
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if(current_ == NIL){
+        return (rhs.current_ == NIL);
+    }
+    return (current_ == rhs.current_) && (tree_ == rhs.tree_);
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator& CompactAVLTree<Key, Value>::iterator::operator++()
+{
+    current_ = tree_->successor(current_);
+    return (*this);
+}
+
+/*
+  -------------------------------------------------------------
+  End implementations for the CompactAVLTree::iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::iterator_range::end() const
+{
+    return last_;
+}
+
+/**
+* Returns true if the range holds no items.
+*/
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::iterator_range::empty() const
+{
+    return first_ == last_;
+}
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  -----------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree; no node array is allocated until
+* the first insert.
+*/
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::CompactAVLTree() :
+    nodes_(nullptr),
+    capacity_(0),
+    used_(0),
+    free_(NIL),
+    size_(0),
+    root_(NIL)
+{
+
+}
+
+/**
+* A deep copy of other in O(n) without comparing any keys: every live
+* node is copied into the same slot, and free slots keep their links, so
+* the copy has the same shape and the same free list.
+*/
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::CompactAVLTree(const CompactAVLTree<Key, Value>& other) :
+    nodes_(nullptr),
+    capacity_(0),
+    used_(0),
+    free_(other.free_),
+    size_(other.size_),
+    root_(other.root_)
+{
+    if(other.used_ == 0){
+        return;
+    }
+    nodes_ = static_cast<CNode*>(::operator new(other.used_ * sizeof(CNode)));
+    capacity_ = other.used_;
+    used_ = other.used_;
+    for(uint32_t curr = other.getSmallestNode(); curr != NIL; curr = other.successor(curr)){
+        new (nodes_ + curr) CNode(other.nodes_[curr]);
+    }
+    for(uint32_t curr = free_; curr != NIL; curr = *reinterpret_cast<uint32_t*>(nodes_ + curr)){
+        new (nodes_ + curr) uint32_t(*reinterpret_cast<uint32_t*>(other.nodes_ + curr));
+    }
+}
+
+/**
+* Takes over other's node array in O(1), leaving other empty.
+*/
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::CompactAVLTree(CompactAVLTree<Key, Value>&& other) :
+    nodes_(other.nodes_),
+    capacity_(other.capacity_),
+    used_(other.used_),
+    free_(other.free_),
+    size_(other.size_),
+    root_(other.root_)
+{
+    other.nodes_ = nullptr;
+    other.capacity_ = 0;
+    other.used_ = 0;
+    other.free_ = NIL;
+    other.size_ = 0;
+    other.root_ = NIL;
+}
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::~CompactAVLTree()
+{
+    clear();
+    ::operator delete(nodes_);
+}
+
+/**
+* Copy or move assignment: other was built by the copy or move
+* constructor, so taking its contents is a swap, and the old nodes go
+* away with other.
+*/
+template<class Key, class Value>
+CompactAVLTree<Key, Value>& CompactAVLTree<Key, Value>::operator=(CompactAVLTree<Key, Value> other)
+{
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1).
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::swap(CompactAVLTree<Key, Value>& other)
+{
+    std::swap(nodes_, other.nodes_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(used_, other.used_);
+    std::swap(free_, other.free_);
+    std::swap(size_, other.size_);
+    std::swap(root_, other.root_);
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::CNode& CompactAVLTree<Key, Value>::node(uint32_t curr) const
+{
+    return nodes_[curr];
+}
+
+/**
+* Inserts keyValuePair, or overwrites the value if the key is already in
+* the tree, then retraces like AVLTree::insert.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    uint32_t parent = NIL;
+    uint32_t curr = root_;
+    while(curr != NIL){
+        if(keyValuePair.first < node(curr).getKey()){
+            parent = curr;
+            curr = node(curr).getLeft();
+        }
+        else if(node(curr).getKey() < keyValuePair.first){
+            parent = curr;
+            curr = node(curr).getRight();
+        }
+        else{
+            node(curr).setValue(keyValuePair.second);
+            return;
+        }
+    }
+    curr = createNode(keyValuePair.first, keyValuePair.second, parent);
+    if(parent == NIL){
+        root_ = curr;
+        return;
+    }
+    if(keyValuePair.first < node(parent).getKey()){
+        node(parent).setLeft(curr);
+    }
+    else{
+        node(parent).setRight(curr);
+    }
+    insertFix(parent, curr);
+}
+
+/**
+* Removes the item with the given key, if any. A node with two children
+* first trades places with its predecessor, as in AVLTree::remove, so
+* iterators to every other node stay valid.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+    uint32_t curr = internalFind(key);
+    if(curr == NIL){
+        return;
+    }
+    if((node(curr).getLeft() != NIL) && (node(curr).getRight() != NIL)){
+        nodeSwap(curr, predecessor(curr));
+    }
+    uint32_t child = node(curr).getLeft();
+    if(child == NIL){
+        child = node(curr).getRight();
+    }
+    uint32_t prev = node(curr).getParent();
+    int8_t diff = 0;
+    if(prev == NIL){
+        root_ = child;
+    }
+    else if(node(prev).getLeft() == curr){
+        node(prev).setLeft(child);
+        diff = 1;
+    }
+    else{
+        node(prev).setRight(child);
+        diff = -1;
+    }
+    if(child != NIL){
+        node(child).setParent(prev);
+    }
+    destroyNode(curr);
+    removeFix(prev, diff);
+}
+
+/**
+* Removes every item. The node array is kept for reuse.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::clear()
+{
+    if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value){
+        clearHelper(root_);
+    }
+    used_ = 0;
+    free_ = NIL;
+    size_ = 0;
+    root_ = NIL;
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::clearHelper(uint32_t curr)
+{
+    if(curr == NIL){
+        return;
+    }
+    clearHelper(node(curr).getLeft());
+    clearHelper(node(curr).getRight());
+    node(curr).~CNode();
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::isBalanced() const
+{
+    return subheight(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at curr, or -1 if any subtree in it
+* is out of balance.
+*/
+template<class Key, class Value>
+int CompactAVLTree<Key, Value>::subheight(uint32_t curr) const
+{
+    if(curr == NIL){
+        return 0;
+    }
+    int left = subheight(node(curr).getLeft());
+    int right = subheight(node(curr).getRight());
+    if((left == -1) || (right == -1) || (left - right > 1) || (right - left > 1)){
+        return -1;
+    }
+    return ((left > right) ? left : right) + 1;
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::empty() const
+{
+    return root_ == NIL;
+}
+
+template<class Key, class Value>
+size_t CompactAVLTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::begin() const
+{
+    return iterator(this, getSmallestNode());
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::end() const
+{
+    return iterator(this, NIL);
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(this, internalFind(key));
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(this, internalLowerBound(key));
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::upper_bound(const Key& key) const
+{
+    return iterator(this, internalUpperBound(key));
+}
+
+template<class Key, class Value>
+std::pair<typename CompactAVLTree<Key, Value>::iterator, typename CompactAVLTree<Key, Value>::iterator>
+CompactAVLTree<Key, Value>::equal_range(const Key& key) const
+{
+    uint32_t first = internalLowerBound(key);
+    uint32_t last = first;
+    if((first != NIL) && !(key < node(first).getKey())){
+        last = successor(first);
+    }
+    return std::make_pair(iterator(this, first), iterator(this, last));
+}
+
+/**
+* Returns the items with lo <= key < hi; empty if hi <= lo.
+*/
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator_range CompactAVLTree<Key, Value>::range(const Key& lo, const Key& hi) const
+{
+    if(!(lo < hi)){
+        return iterator_range(end(), end());
+    }
+    return iterator_range(lower_bound(lo), lower_bound(hi));
+}
+
+template<class Key, class Value>
+Value& CompactAVLTree<Key, Value>::operator[](const Key& key)
+{
+    uint32_t curr = internalFind(key);
+    if(curr == NIL) throw std::out_of_range("Invalid key");
+    return node(curr).getValue();
+}
+
+template<class Key, class Value>
+Value const & CompactAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    uint32_t curr = internalFind(key);
+    if(curr == NIL) throw std::out_of_range("Invalid key");
+    return node(curr).getValue();
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    uint32_t curr = root_;
+    while(curr != NIL){
+        if(key == node(curr).getKey()){
+            break;
+        }
+        else if(key < node(curr).getKey()){
+            curr = node(curr).getLeft();
+        }
+        else{
+            curr = node(curr).getRight();
+        }
+    }
+    return curr;
+}
+
+/**
+* Returns the first node whose key is not less than key, or NIL.
+*/
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::internalLowerBound(const Key& key) const
+{
+    uint32_t result = NIL;
+    uint32_t curr = root_;
+    while(curr != NIL){
+        if(node(curr).getKey() < key){
+            curr = node(curr).getRight();
+        }
+        else{
+            result = curr;
+            curr = node(curr).getLeft();
+        }
+    }
+    return result;
+}
+
+/**
+* Returns the first node whose key is greater than key, or NIL.
+*/
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::internalUpperBound(const Key& key) const
+{
+    uint32_t result = NIL;
+    uint32_t curr = root_;
+    while(curr != NIL){
+        if(key < node(curr).getKey()){
+            result = curr;
+            curr = node(curr).getLeft();
+        }
+        else{
+            curr = node(curr).getRight();
+        }
+    }
+    return result;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::getSmallestNode() const
+{
+    uint32_t curr = root_;
+    if(curr == NIL){
+        return NIL;
+    }
+    while(node(curr).getLeft() != NIL){
+        curr = node(curr).getLeft();
+    }
+    return curr;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::successor(uint32_t curr) const
+{
+    uint32_t next = node(curr).getRight();
+    if(next != NIL){
+        while(node(next).getLeft() != NIL){
+            next = node(next).getLeft();
+        }
+        return next;
+    }
+    next = node(curr).getParent();
+    while((next != NIL) && (node(next).getRight() == curr)){
+        curr = next;
+        next = node(next).getParent();
+    }
+    return next;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::predecessor(uint32_t curr) const
+{
+    uint32_t prev = node(curr).getLeft();
+    if(prev != NIL){
+        while(node(prev).getRight() != NIL){
+            prev = node(prev).getRight();
+        }
+        return prev;
+    }
+    prev = node(curr).getParent();
+    while((prev != NIL) && (node(prev).getLeft() == curr)){
+        curr = prev;
+        prev = node(prev).getParent();
+    }
+    return prev;
+}
+
+/**
+* Constructs a node in a free slot, taken from the free list if possible
+* and otherwise from the end of the array, and returns its index.
+*/
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::createNode(const Key& key, const Value& value, uint32_t parent)
+{
+    uint32_t curr = free_;
+    if(curr != NIL){
+        free_ = *reinterpret_cast<uint32_t*>(nodes_ + curr);
+    }
+    else{
+        if(used_ == capacity_){
+            grow();
+        }
+        curr = used_++;
+    }
+    new (nodes_ + curr) CNode(key, value, parent);
+    size_++;
+    return curr;
+}
+
+/**
+* Destroys the node and puts its slot on the free list; the slot's first
+* bytes hold the index of the next free slot.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::destroyNode(uint32_t curr)
+{
+    nodes_[curr].~CNode();
+    new (nodes_ + curr) uint32_t(free_);
+    free_ = curr;
+    size_--;
+}
+
+/**
+* Doubles the node array. Only called with an empty free list, so every
+* slot in [0, used_) holds a live node to move over.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::grow()
+{
+    if(capacity_ == NIL){
+        throw std::length_error("CompactAVLTree: too many nodes");
+    }
+    uint32_t capacity = (capacity_ == 0) ? 16 : capacity_ * 2;
+    if(capacity > NIL){
+        capacity = NIL;
+    }
+    CNode* nodes = static_cast<CNode*>(::operator new(capacity * sizeof(CNode)));
+    for(uint32_t i = 0; i < used_; i++){
+        new (nodes + i) CNode(std::move(nodes_[i]));
+        nodes_[i].~CNode();
+    }
+    ::operator delete(nodes_);
+    nodes_ = nodes;
+    capacity_ = capacity;
+}
+
+/**
+ * Retraces from the newly attached node curr up through its parent prev.
+ * A balance of -2 or 2 cannot be stored in the node, so it is handed to
+ * rebalance directly.
+ */
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insertFix(uint32_t prev, uint32_t curr)
+{
+    while(prev != NIL){
+        int8_t balance = node(prev).getBalance() + ((node(prev).getLeft() == curr) ? -1 : 1);
+        if(balance == 0){
+            node(prev).setBalance(0);
+            return;
+        }
+        if((balance < -1) || (balance > 1)){
+            rebalance(prev, balance);
+            return;
+        }
+        node(prev).setBalance(balance);
+        curr = prev;
+        prev = node(prev).getParent();
+    }
+}
+
+/**
+ * Retraces after a node was unlinked below curr, as AVLTree::removeFix.
+ */
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::removeFix(uint32_t curr, int8_t diff)
+{
+    while(curr != NIL){
+        uint32_t prev = node(curr).getParent();
+        int8_t nextDiff = 0;
+        if(prev != NIL){
+            nextDiff = (node(prev).getLeft() == curr) ? 1 : -1;
+        }
+        int8_t balance = node(curr).getBalance() + diff;
+        if((balance == -1) || (balance == 1)){
+            node(curr).setBalance(balance);
+            return;
+        }
+        if(balance == 0){
+            node(curr).setBalance(0);
+        }
+        else{
+            uint32_t heavy = (balance < 0) ? node(curr).getLeft() : node(curr).getRight();
+            bool evenChild = (node(heavy).getBalance() == 0);
+            rebalance(curr, balance);
+            if(evenChild){
+                return;
+            }
+        }
+        curr = prev;
+        diff = nextDiff;
+    }
+}
+
+/**
+ * Rotates the subtree rooted at prev, whose balance is -2 or 2, back into
+ * AVL shape, as AVLTree::rebalance. Returns the new root of the subtree.
+ */
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::rebalance(uint32_t prev, int8_t balance)
+{
+    if(balance < 0){
+        uint32_t curr = node(prev).getLeft();
+        if(node(curr).getBalance() <= 0){
+            insertLeft(prev);
+            if(node(curr).getBalance() == 0){
+                node(prev).setBalance(-1);
+                node(curr).setBalance(1);
+            }
+            else{
+                node(prev).setBalance(0);
+                node(curr).setBalance(0);
+            }
+            return curr;
+        }
+        uint32_t next = node(curr).getRight();
+        int8_t nextBalance = node(next).getBalance();
+        insertRight(curr);
+        insertLeft(prev);
+        node(curr).setBalance((nextBalance > 0) ? -1 : 0);
+        node(prev).setBalance((nextBalance < 0) ? 1 : 0);
+        node(next).setBalance(0);
+        return next;
+    }
+    uint32_t curr = node(prev).getRight();
+    if(node(curr).getBalance() >= 0){
+        insertRight(prev);
+        if(node(curr).getBalance() == 0){
+            node(prev).setBalance(1);
+            node(curr).setBalance(-1);
+        }
+        else{
+            node(prev).setBalance(0);
+            node(curr).setBalance(0);
+        }
+        return curr;
+    }
+    uint32_t next = node(curr).getLeft();
+    int8_t nextBalance = node(next).getBalance();
+    insertLeft(curr);
+    insertRight(prev);
+    node(curr).setBalance((nextBalance < 0) ? 1 : 0);
+    node(prev).setBalance((nextBalance > 0) ? -1 : 0);
+    node(next).setBalance(0);
+    return next;
+}
+
+/**
+* Points whichever link of parent refers to oldChild (or the root, if
+* parent is NIL) at newChild.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::replaceChild(uint32_t parent, uint32_t oldChild, uint32_t newChild)
+{
+    if(parent == NIL){
+        root_ = newChild;
+    }
+    else if(node(parent).getLeft() == oldChild){
+        node(parent).setLeft(newChild);
+    }
+    else{
+        node(parent).setRight(newChild);
+    }
+}
+
+/**
+* Rotates right around pare.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insertLeft(uint32_t pare)
+{
+    uint32_t prev = node(pare).getLeft();
+    uint32_t temp = node(prev).getRight();
+    uint32_t parent = node(pare).getParent();
+    replaceChild(parent, pare, prev);
+    node(prev).setParent(parent);
+    node(prev).setRight(pare);
+    node(pare).setParent(prev);
+    node(pare).setLeft(temp);
+    if(temp != NIL){
+        node(temp).setParent(pare);
+    }
+}
+
+/**
+* Rotates left around pare.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insertRight(uint32_t pare)
+{
+    uint32_t prev = node(pare).getRight();
+    uint32_t temp = node(prev).getLeft();
+    uint32_t parent = node(pare).getParent();
+    replaceChild(parent, pare, prev);
+    node(prev).setParent(parent);
+    node(prev).setLeft(pare);
+    node(pare).setParent(prev);
+    node(pare).setRight(temp);
+    if(temp != NIL){
+        node(temp).setParent(pare);
+    }
+}
+
+/**
+* Swaps the positions of n1 and n2 in the tree, balances included, as
+* BinarySearchTree::nodeSwap and AVLTree::nodeSwap do for pointer nodes.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::nodeSwap(uint32_t n1, uint32_t n2)
+{
+    if((n1 == n2) || (n1 == NIL) || (n2 == NIL)){
+        return;
+    }
+    uint32_t n1p = node(n1).getParent();
+    uint32_t n1r = node(n1).getRight();
+    uint32_t n1lt = node(n1).getLeft();
+    bool n1isLeft = (n1p != NIL) && (node(n1p).getLeft() == n1);
+    uint32_t n2p = node(n2).getParent();
+    uint32_t n2r = node(n2).getRight();
+    uint32_t n2lt = node(n2).getLeft();
+    bool n2isLeft = (n2p != NIL) && (node(n2p).getLeft() == n2);
+
+    node(n1).setParent(n2p);
+    node(n2).setParent(n1p);
+    node(n1).setLeft(n2lt);
+    node(n2).setLeft(n1lt);
+    node(n1).setRight(n2r);
+    node(n2).setRight(n1r);
+
+    if(n1r == n2){
+        node(n2).setRight(n1);
+        node(n1).setParent(n2);
+    }
+    else if(n2r == n1){
+        node(n1).setRight(n2);
+        node(n2).setParent(n1);
+    }
+    else if(n1lt == n2){
+        node(n2).setLeft(n1);
+        node(n1).setParent(n2);
+    }
+    else if(n2lt == n1){
+        node(n1).setLeft(n2);
+        node(n2).setParent(n1);
+    }
+
+    if((n1p != NIL) && (n1p != n2)){
+        if(n1isLeft) node(n1p).setLeft(n2);
+        else node(n1p).setRight(n2);
+    }
+    if((n1r != NIL) && (n1r != n2)){
+        node(n1r).setParent(n2);
+    }
+    if((n1lt != NIL) && (n1lt != n2)){
+        node(n1lt).setParent(n2);
+    }
+    if((n2p != NIL) && (n2p != n1)){
+        if(n2isLeft) node(n2p).setLeft(n1);
+        else node(n2p).setRight(n1);
+    }
+    if((n2r != NIL) && (n2r != n1)){
+        node(n2r).setParent(n1);
+    }
+    if((n2lt != NIL) && (n2lt != n1)){
+        node(n2lt).setParent(n1);
+    }
+
+    if(root_ == n1){
+        root_ = n2;
+    }
+    else if(root_ == n2){
+        root_ = n1;
+    }
+
+    int8_t tempB = node(n1).getBalance();
+    node(n1).setBalance(node(n2).getBalance());
+    node(n2).setBalance(tempB);
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the CompactAVLTree class.
+  ---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,532 @@
+#ifndef CONCURRENTAVLBST_H
+#define CONCURRENTAVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVL node whose child links can be stored with release ordering and
+* loaded with acquire ordering, for the lock-free readers of
+* ConcurrentAVLTree. A reader that loads a link then sees the node it
+* points to fully built. On x86 both are plain moves.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    template<typename... Args>
+    ConcurrentAVLNode(ConcurrentAVLNode<Key, Value>* parent, Args&&... args);
+    ~ConcurrentAVLNode();
+
+    // The right or left child, for readers racing with the writer.
+    ConcurrentAVLNode<Key, Value>* loadChild(bool right) const;
+
+    // Setters for the writer, ordered for loadChild.
+    void publishLeft(Node<Key, Value>* left);
+    void publishRight(Node<Key, Value>* right);
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the ConcurrentAVLNode class.
+  -----------------------------------------------------
+*/
+
+/**
+* Constructs the item in place; see Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(ConcurrentAVLNode<Key, Value> *parent, Args&&... args) :
+    AVLNode<Key, Value>(parent, std::forward<Args>(args)...)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>::~ConcurrentAVLNode()
+{
+
+}
+
+/**
+* Loads both links and then picks one. The loads do not wait for the key
+* comparison, and the pick compiles to a conditional move, as in
+* BinarySearchTree's own descent; compilers do not turn a choice between
+* two atomic loads into one.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::loadChild(bool right) const
+{
+    Node<Key, Value>* left = __atomic_load_n(&this->left_, __ATOMIC_ACQUIRE);
+    Node<Key, Value>* other = __atomic_load_n(&this->right_, __ATOMIC_ACQUIRE);
+    return static_cast<ConcurrentAVLNode<Key, Value>*>(right ? other : left);
+}
+
+/**
+* Sets the left child with a release store.
+*/
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::publishLeft(Node<Key, Value>* left)
+{
+    __atomic_store_n(&this->left_, left, __ATOMIC_RELEASE);
+}
+
+/**
+* Sets the right child with a release store.
+*/
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::publishRight(Node<Key, Value>* right)
+{
+    __atomic_store_n(&this->right_, right, __ATOMIC_RELEASE);
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the ConcurrentAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* An AVL tree shared between threads, for read-mostly use. Writers take
+* a mutex; readers take no lock at all.
+*
+* Writers bump a sequence count to odd before changing the tree and back
+* to even after, like a seqlock. A reader notes the count, descends from
+* the root, and checks the count again after every link it follows: if a
+* write got in, it starts over. So a reader never acts on more than one
+* link read from a tree in the middle of a rotation, and cannot be caught
+* in the loop a half done rotation briefly makes.
+*
+* The key and value of a node never change once the node is linked in:
+* overwriting a key puts a new node in place of the old one. Readers can
+* therefore copy a value out of any node they reach without racing with
+* the writer, and Value need not be trivially copyable.
+*
+* Unlinked nodes are freed by epoch-based reclamation. A reader announces
+* the count it saw in a slot of its own before it descends, and clears the
+* slot when done. A node unlinked by the write that ended at count E is
+* only freed once no announced count is below E, i.e. once every reader
+* that might still hold it has finished. Reclamation runs at the end of
+* each write.
+*
+* At most READER_SLOTS (128) readers hold a slot at a time; further
+* readers yield until one is released, so more reader threads than that
+* still work but queue for slots.
+*
+* Readers are get() and contains(); writers are insert(), update() and
+* remove(). The rest of the AVLTree interface is not thread safe and is
+* not exposed.
+*/
+template <class Key, class Value>
+class ConcurrentAVLTree : protected AVLTree<Key, Value, std::less<Key>, ConcurrentAVLTree<Key, Value> >
+{
+protected:
+    typedef AVLTree<Key, Value, std::less<Key>, ConcurrentAVLTree<Key, Value> > Base;
+    typedef ConcurrentAVLNode<Key, Value> ConcurrentNode;
+    friend class BinarySearchTree<Key, Value>;
+    friend class AVLTree<Key, Value, std::less<Key>, ConcurrentAVLTree<Key, Value> >;
+
+public:
+    // Readers that can be active at the same time; more wait for a slot.
+    static const size_t READER_SLOTS = 128;
+
+    ConcurrentAVLTree();
+    virtual ~ConcurrentAVLTree();
+
+    // Writers; they run one at a time.
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    template<typename F>
+    bool update(const Key& key, F fn);
+    virtual void remove(const Key& key);
+
+    // Readers; they take no lock.
+    bool get(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+
+protected:
+    // A reader's announced count, alone on its cache line.
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> seq;
+    };
+
+    static const uint64_t IDLE = ~static_cast<uint64_t>(0);
+
+    // Node hooks, see BinarySearchTree.
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    void destroyNode(Node<Key, Value>* curr);
+    void setRoot(Node<Key, Value>* root);
+    void publishLeft(Node<Key, Value>* parent, Node<Key, Value>* child);
+    void publishRight(Node<Key, Value>* parent, Node<Key, Value>* child);
+
+    void beginWrite();
+    void endWrite();
+    void replaceNode(Node<Key, Value>* old, Node<Key, Value>* fresh);
+    void reclaim();
+    ReaderSlot* pin() const;
+    void unpin(ReaderSlot* slot) const;
+    ConcurrentNode* loadRoot() const;
+    template<typename F>
+    bool read(const Key& key, F& fn) const;
+    ConcurrentNode* descend(const Key& key, uint64_t seq, std::true_type scalar) const;
+    ConcurrentNode* descend(const Key& key, uint64_t seq, std::false_type scalar) const;
+
+    std::mutex writer_;
+    std::atomic<uint64_t> seq_;
+    mutable ReaderSlot slots_[READER_SLOTS];
+    std::vector<std::pair<uint64_t, Node<Key, Value>*> > retired_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the ConcurrentAVLTree class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value>
+const size_t ConcurrentAVLTree<Key, Value>::READER_SLOTS;
+
+template<class Key, class Value>
+const uint64_t ConcurrentAVLTree<Key, Value>::IDLE;
+
+/**
+* Default constructor for an empty tree with no readers.
+*/
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree() : Base(), seq_(0)
+{
+    for(size_t i = 0; i < READER_SLOTS; i++){
+        slots_[i].seq.store(IDLE, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Frees the retired nodes and then the tree. No reader may be active.
+*/
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+    reclaim();
+    this->clear();
+}
+
+/**
+* Inserts the item, or replaces the node holding its key by a new one.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::lock_guard<std::mutex> lock(writer_);
+    beginWrite();
+    Node<Key, Value>* found = this->internalFind(keyValuePair.first);
+    if(found == nullptr){
+        Base::insert(keyValuePair);
+    }
+    else{
+        replaceNode(found, createNode(found->getParent(), keyValuePair));
+    }
+    endWrite();
+}
+
+/**
+* Calls fn on a copy of the value of key and puts the result in place of
+* the node, as insert does. Returns false, without calling fn, if key is
+* not in the tree.
+*/
+template<class Key, class Value>
+template<typename F>
+bool ConcurrentAVLTree<Key, Value>::update(const Key& key, F fn)
+{
+    std::lock_guard<std::mutex> lock(writer_);
+    Node<Key, Value>* found = this->internalFind(key);
+    if(found == nullptr){
+        return false;
+    }
+    Value value(found->getValue());
+    fn(value);
+    beginWrite();
+    replaceNode(found, createNode(found->getParent(), key, std::move(value)));
+    endWrite();
+    return true;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> lock(writer_);
+    beginWrite();
+    Base::remove(key);
+    endWrite();
+}
+
+/**
+* Copies the value of key into value and returns true, or returns false
+* and leaves value alone if key is not in the tree.
+*/
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::get(const Key& key, Value& value) const
+{
+    auto copy = [&value](const Value& found){ value = found; };
+    return read(key, copy);
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+    auto ignore = [](const Value&){ };
+    return read(key, ignore);
+}
+
+/**
+* Looks key up without a lock and, if it is there, calls fn on its value
+* once, and returns true. fn only ever sees the node of an attempt that
+* validated: a value is never changed in place (writers replace the
+* node), and the node cannot be freed while this reader is pinned, so it
+* is read after the check rather than inside it.
+*/
+template<class Key, class Value>
+template<typename F>
+bool ConcurrentAVLTree<Key, Value>::read(const Key& key, F& fn) const
+{
+    ReaderSlot* slot = pin();
+    while(true){
+        uint64_t seq = seq_.load(std::memory_order_seq_cst);
+        if(seq & 1){
+            std::this_thread::yield();
+            continue;
+        }
+        ConcurrentNode* found = descend(key, seq, std::integral_constant<bool, ScalarCompare<Key, std::less<Key> >::value>());
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(seq_.load(std::memory_order_relaxed) == seq){
+            if(found != nullptr){
+                fn(found->getValue());
+            }
+            unpin(slot);
+            return (found != nullptr);
+        }
+    }
+}
+
+/**
+* Finds key for read, as internalFindParent does: scalar keys are tested
+* for equality on the way down, other keys by one comparison per level and
+* a last one at the bottom. Stops early, with any node, once the count is
+* no longer seq; read then starts over.
+*/
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::ConcurrentNode*
+ConcurrentAVLTree<Key, Value>::descend(const Key& key, uint64_t seq, std::true_type scalar) const
+{
+    ConcurrentNode* curr = loadRoot();
+    while((curr != nullptr) && !(key == curr->getKey()) && (seq_.load(std::memory_order_acquire) == seq)){
+        curr = curr->loadChild(!std::less<Key>()(key, curr->getKey()));
+    }
+    return curr;
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::ConcurrentNode*
+ConcurrentAVLTree<Key, Value>::descend(const Key& key, uint64_t seq, std::false_type scalar) const
+{
+    ConcurrentNode* curr = loadRoot();
+    ConcurrentNode* floor = nullptr;
+    while((curr != nullptr) && (seq_.load(std::memory_order_acquire) == seq)){
+        bool right = !std::less<Key>()(key, curr->getKey());
+        if(right){
+            floor = curr;
+        }
+        curr = curr->loadChild(right);
+    }
+    if((floor == nullptr) || std::less<Key>()(floor->getKey(), key)){
+        return nullptr;
+    }
+    return floor;
+}
+
+template<class Key, class Value>
+template<typename... Args>
+Node<Key, Value>* ConcurrentAVLTree<Key, Value>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (this->template allocateNode<ConcurrentNode>()) ConcurrentNode(static_cast<ConcurrentNode*>(parent), std::forward<Args>(args)...);
+}
+
+/**
+* Retires a node unlinked by a write, to be freed by reclaim once no
+* reader can hold it. Outside a write, which only happens when the
+* destructor clears the tree, the node is freed at once.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::destroyNode(Node<Key, Value>* curr)
+{
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    if(seq & 1){
+        retired_.push_back(std::make_pair(seq + 1, curr));
+    }
+    else{
+        this->freeNode(static_cast<ConcurrentNode*>(curr));
+    }
+}
+
+/**
+* The root, stored with the same ordering as ConcurrentAVLNode's links.
+* Together with publishLeft and publishRight this covers every link the
+* writers change: AVLTree's insert, remove and rotations and nodeSwap
+* write them through these hooks. The bulk operations that set root_
+* directly are not exposed.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::setRoot(Node<Key, Value>* root)
+{
+    __atomic_store_n(&this->root_, root, __ATOMIC_RELEASE);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::publishLeft(Node<Key, Value>* parent, Node<Key, Value>* child)
+{
+    static_cast<ConcurrentNode*>(parent)->publishLeft(child);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::publishRight(Node<Key, Value>* parent, Node<Key, Value>* child)
+{
+    static_cast<ConcurrentNode*>(parent)->publishRight(child);
+}
+
+/**
+* Makes the count odd; readers that see it, or any link written after
+* it, start over.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::beginWrite()
+{
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+* Makes the count even again and frees what readers can no longer reach.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::endWrite()
+{
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    reclaim();
+}
+
+/**
+* Puts fresh, a new node with the same key, where old is in the tree and
+* retires old. fresh takes over old's links and balance before its parent
+* points to it, so readers find either node whole.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::replaceNode(Node<Key, Value>* old, Node<Key, Value>* fresh)
+{
+    Node<Key, Value>* parent = old->getParent();
+    fresh->setLeft(old->getLeft());
+    fresh->setRight(old->getRight());
+    static_cast<AVLNode<Key, Value>*>(fresh)->setBalance(static_cast<AVLNode<Key, Value>*>(old)->getBalance());
+    if(old->getLeft() != nullptr){
+        old->getLeft()->setParent(fresh);
+    }
+    if(old->getRight() != nullptr){
+        old->getRight()->setParent(fresh);
+    }
+    if(this->leftmost_ == old){
+        this->leftmost_ = fresh;
+    }
+    if(this->rightmost_ == old){
+        this->rightmost_ = fresh;
+    }
+    if(parent == nullptr){
+        setRoot(fresh);
+    }
+    else if(parent->getLeft() == old){
+        publishLeft(parent, fresh);
+    }
+    else{
+        publishRight(parent, fresh);
+    }
+    destroyNode(old);
+}
+
+/**
+* Frees every retired node that no active reader can hold: those retired
+* at a count no announced count is below.
+*/
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::reclaim()
+{
+    if(retired_.empty()){
+        return;
+    }
+    uint64_t oldest = IDLE;
+    for(size_t i = 0; i < READER_SLOTS; i++){
+        oldest = std::min(oldest, slots_[i].seq.load(std::memory_order_seq_cst));
+    }
+    size_t kept = 0;
+    for(size_t i = 0; i < retired_.size(); i++){
+        if(retired_[i].first <= oldest){
+            this->freeNode(static_cast<ConcurrentNode*>(retired_[i].second));
+        }
+        else{
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+}
+
+/**
+* Announces the current count in a free slot, starting from one that
+* depends on the thread so that threads usually keep to their own. If
+* every slot is taken, yields after each full pass so that the readers
+* holding them get to run and let go.
+*/
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::ReaderSlot*
+ConcurrentAVLTree<Key, Value>::pin() const
+{
+    static std::atomic<size_t> nextSlot(0);
+    static thread_local size_t first = nextSlot.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+    while(true){
+        uint64_t seq = seq_.load(std::memory_order_seq_cst);
+        for(size_t n = 0, i = first; n < READER_SLOTS; n++, i = (i + 1) % READER_SLOTS){
+            uint64_t idle = IDLE;
+            if(slots_[i].seq.compare_exchange_strong(idle, seq, std::memory_order_seq_cst)){
+                return &slots_[i];
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::unpin(ReaderSlot* slot) const
+{
+    slot->seq.store(IDLE, std::memory_order_release);
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::ConcurrentNode*
+ConcurrentAVLTree<Key, Value>::loadRoot() const
+{
+    return static_cast<ConcurrentNode*>(__atomic_load_n(&this->root_, __ATOMIC_ACQUIRE));
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the ConcurrentAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
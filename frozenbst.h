@@ -0,0 +1,474 @@
+#ifndef FROZENBST_H
+#define FROZENBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+* An immutable snapshot of a search tree, made by
+* BinarySearchTree::freeze(), laid out for lookups.
+*
+* Keys are kept apart from the items in an array in Eytzinger (BFS)
+* order: the root is at index 1 and the children of k at 2k and 2k+1.
+* A search is then a chain of array reads with no pointers, and the
+* descendants of k four levels down (for 4-byte keys) share one cache
+* line, so each step can prefetch the line it will need a few levels
+* later while it waits on the current one. The step itself is
+* k = 2k + (keys_[k] < key), with no branch on the comparison.
+*
+* Items are stored in the same order, so a search yields the item
+* directly. In-order iteration walks the implicit tree. Keys are ordered
+* by Compare, which must be the ordering of the tree that was frozen.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    FrozenTree();
+    template<typename InputIt>
+    FrozenTree(InputIt first, InputIt last, const Compare& comp = Compare());
+    FrozenTree(const FrozenTree<Key, Value, Compare>& other);
+    FrozenTree(FrozenTree<Key, Value, Compare>&& other);
+    FrozenTree<Key, Value, Compare>& operator=(FrozenTree<Key, Value, Compare> other);
+    ~FrozenTree();
+
+    size_t size() const;
+    bool empty() const;
+
+    /**
+    * A read-only iterator over the snapshot in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class FrozenTree<Key, Value, Compare>;
+        iterator(const FrozenTree<Key, Value, Compare>* tree, size_t curr);
+        const FrozenTree<Key, Value, Compare>* tree_;
+        size_t current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+    static const size_t CACHE_LINE = 64;
+
+    static size_t prefetchStride();
+    static void prefetch(const void* addr);
+    static size_t trailingOnes(size_t k);
+
+    size_t internalLowerBound(const Key& key) const;
+    size_t internalUpperBound(const Key& key) const;
+    size_t successor(size_t k) const;
+    void layout(size_t k, size_t& rank, std::vector<size_t>& order) const;
+    void allocate();
+    void release();
+
+    Compare comp_;
+    size_t size_;
+    char* storage_;
+    Key* keys_;                            // keys_[1..size_], Eytzinger order
+    std::pair<const Key, Value>* items_;   // items_[1..size_], same order
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the FrozenTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::iterator::iterator(const FrozenTree<Key, Value, Compare>* tree, size_t curr) :
+    tree_(tree),
+    current_(curr)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(nullptr),
+    current_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>& FrozenTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->items_[current_];
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>* FrozenTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->items_[current_]);
+}
+
+/**
+* Two iterators are equal if they are at the same item; every end()
+* iterator is equal to every other one.
+*/
+template<class Key, class Value, class Compare>
+bool FrozenTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if(current_ == 0){
+        return (rhs.current_ == 0);
+    }
+    return (current_ == rhs.current_) && (tree_ == rhs.tree_);
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator& FrozenTree<Key, Value, Compare>::iterator::operator++()
+{
+    current_ = tree_->successor(current_);
+    return (*this);
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the FrozenTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the FrozenTree class.
+  -----------------------------------------------
+*/
+
+/**
+* An empty snapshot.
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree() :
+    comp_(),
+    size_(0),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+
+}
+
+/**
+* Builds the snapshot from items sorted by strictly increasing key, as
+* produced by iterating a tree. An in-order walk of the implicit tree
+* gives the Eytzinger slot of each item in turn.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+FrozenTree<Key, Value, Compare>::FrozenTree(InputIt first, InputIt last, const Compare& comp) :
+    comp_(comp),
+    size_(0),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+    std::vector<std::pair<Key, Value> > sorted;
+    for(; first != last; ++first){
+        sorted.push_back(std::pair<Key, Value>(first->first, first->second));
+    }
+    size_ = sorted.size();
+    if(size_ == 0){
+        return;
+    }
+    std::vector<size_t> order(size_ + 1);
+    size_t rank = 0;
+    layout(1, rank, order);
+    allocate();
+    for(size_t k = 1; k <= size_; k++){
+        new (keys_ + k) Key(sorted[order[k]].first);
+        new (items_ + k) std::pair<const Key, Value>(sorted[order[k]].first, sorted[order[k]].second);
+    }
+}
+
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree(const FrozenTree<Key, Value, Compare>& other) :
+    comp_(other.comp_),
+    size_(other.size_),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+    if(size_ == 0){
+        return;
+    }
+    allocate();
+    for(size_t k = 1; k <= size_; k++){
+        new (keys_ + k) Key(other.keys_[k]);
+        new (items_ + k) std::pair<const Key, Value>(other.items_[k]);
+    }
+}
+
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree(FrozenTree<Key, Value, Compare>&& other) :
+    comp_(other.comp_),
+    size_(other.size_),
+    storage_(other.storage_),
+    keys_(other.keys_),
+    items_(other.items_)
+{
+    other.size_ = 0;
+    other.storage_ = nullptr;
+    other.keys_ = nullptr;
+    other.items_ = nullptr;
+}
+
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>& FrozenTree<Key, Value, Compare>::operator=(FrozenTree<Key, Value, Compare> other)
+{
+    std::swap(comp_, other.comp_);
+    std::swap(size_, other.size_);
+    std::swap(storage_, other.storage_);
+    std::swap(keys_, other.keys_);
+    std::swap(items_, other.items_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::~FrozenTree()
+{
+    release();
+}
+
+/**
+* Gets storage for size_ keys and items, 1-indexed, with keys_ on a cache
+* line boundary so that each group of siblings the search prefetches is
+* one aligned line.
+*/
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::allocate()
+{
+    size_t keyBytes = (size_ + 1) * sizeof(Key);
+    keyBytes = (keyBytes + alignof(std::pair<const Key, Value>) - 1) / alignof(std::pair<const Key, Value>) * alignof(std::pair<const Key, Value>);
+    size_t itemBytes = (size_ + 1) * sizeof(std::pair<const Key, Value>);
+    storage_ = static_cast<char*>(::operator new(keyBytes + itemBytes + CACHE_LINE));
+    size_t offset = (CACHE_LINE - reinterpret_cast<uintptr_t>(storage_) % CACHE_LINE) % CACHE_LINE;
+    keys_ = reinterpret_cast<Key*>(storage_ + offset);
+    items_ = reinterpret_cast<std::pair<const Key, Value>*>(storage_ + offset + keyBytes);
+}
+
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::release()
+{
+    for(size_t k = 1; k <= size_; k++){
+        keys_[k].~Key();
+        items_[k].~Item();
+    }
+    ::operator delete(storage_);
+    size_ = 0;
+    storage_ = nullptr;
+    keys_ = nullptr;
+    items_ = nullptr;
+}
+
+/**
+* Visits the implicit subtree at k in order, recording in order[k] the
+* rank of the item that goes in slot k.
+*/
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::layout(size_t k, size_t& rank, std::vector<size_t>& order) const
+{
+    if(k > size_){
+        return;
+    }
+    layout(2 * k, rank, order);
+    order[k] = rank++;
+    layout(2 * k + 1, rank, order);
+}
+
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Starts at the leftmost slot of the implicit tree.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::begin() const
+{
+    if(size_ == 0){
+        return end();
+    }
+    size_t k = 1;
+    while(2 * k <= size_){
+        k = 2 * k;
+    }
+    return iterator(this, k);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::end() const
+{
+    return iterator(this, 0);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    size_t k = internalLowerBound(key);
+    if((k == 0) || comp_(key, keys_[k])){
+        return end();
+    }
+    return iterator(this, k);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iterator(this, internalLowerBound(key));
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return iterator(this, internalUpperBound(key));
+}
+
+template<class Key, class Value, class Compare>
+Value const & FrozenTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* How many slots ahead of 2k the search prefetches: as many keys as fit
+* in a cache line, rounded down to a power of two so the group starts on
+* a line boundary.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::prefetchStride()
+{
+    size_t stride = 1;
+    while(stride * 2 * sizeof(Key) <= CACHE_LINE){
+        stride *= 2;
+    }
+    return stride;
+}
+
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::prefetch(const void* addr)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(addr);
+#endif
+}
+
+/**
+* The number of low one bits of k.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::trailingOnes(size_t k)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(~static_cast<unsigned long long>(k));
+#else
+    size_t count = 0;
+    while(k & 1){
+        k >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+* Branch-free descent to the first key not less than key. Each step goes
+* right when keys_[k] < key; once past the leaves, k records the path
+* taken, and stripping the trailing right turns plus the last left turn
+* leaves the slot where the search last went left, i.e. the answer (0 if
+* it never went left).
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::internalLowerBound(const Key& key) const
+{
+    const size_t stride = prefetchStride();
+    size_t k = 1;
+    while(k <= size_){
+        prefetch(keys_ + stride * k);
+        k = 2 * k + comp_(keys_[k], key);
+    }
+    return k >> (trailingOnes(k) + 1);
+}
+
+/**
+* As internalLowerBound, for the first key greater than key.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::internalUpperBound(const Key& key) const
+{
+    const size_t stride = prefetchStride();
+    size_t k = 1;
+    while(k <= size_){
+        prefetch(keys_ + stride * k);
+        k = 2 * k + !comp_(key, keys_[k]);
+    }
+    return k >> (trailingOnes(k) + 1);
+}
+
+/**
+* The in-order successor of slot k: the leftmost slot of its right
+* subtree, or else the nearest ancestor it is a left descendant of.
+* Returns 0 past the last item.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenTree<Key, Value, Compare>::successor(size_t k) const
+{
+    if(2 * k + 1 <= size_){
+        k = 2 * k + 1;
+        while(2 * k <= size_){
+            k = 2 * k;
+        }
+        return k;
+    }
+    return k >> (trailingOnes(k) + 1);
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the FrozenTree class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,502 @@
+#ifndef FROZENBTREE_H
+#define FROZENBTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "simdsearch.h"
+
+/**
+* An immutable snapshot of a search tree, made by
+* BinarySearchTree::freezeBlocks(), laid out as a static B-tree for
+* lookups with SIMD block comparisons.
+*
+* Keys are grouped in blocks of B = BlockRank<Key>::WIDTH, one cache line
+* for integral keys (16 4-byte or 8 8-byte keys). Blocks are numbered in
+* BFS order like the slots of FrozenTree: block k has B + 1 children, the
+* i-th at k(B+1) + i + 1. Slot j is key j % B of block j / B. A search
+* ranks the key against a whole block with one kernel call, which both
+* picks the candidate answer in that block and the child to go to next,
+* so it touches one line per level and there are log_(B+1) n levels.
+*
+* The last block is padded with copies of the largest key. Padding only
+* counts when the key is past every item, and slots past the end are
+* never taken as an answer, so the kernels see whole blocks.
+*
+* The kernel is picked from CPUID on construction; useKernel() selects
+* another, e.g. the scalar one, and any of them gives the same results.
+*/
+template <typename Key, typename Value>
+class FrozenBTree
+{
+public:
+    FrozenBTree();
+    template<typename InputIt>
+    FrozenBTree(InputIt first, InputIt last);
+    FrozenBTree(const FrozenBTree<Key, Value>& other);
+    FrozenBTree(FrozenBTree<Key, Value>&& other);
+    FrozenBTree<Key, Value>& operator=(FrozenBTree<Key, Value> other);
+    ~FrozenBTree();
+
+    size_t size() const;
+    bool empty() const;
+    SearchKernel kernel() const;
+    void useKernel(SearchKernel kernel);
+
+    /**
+    * A read-only iterator over the snapshot in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class FrozenBTree<Key, Value>;
+        iterator(const FrozenBTree<Key, Value>* tree, size_t curr);
+        const FrozenBTree<Key, Value>* tree_;
+        size_t current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+    typedef typename BlockRank<Key>::Function RankFunction;
+    static const size_t B = BlockRank<Key>::WIDTH;
+    static const size_t CACHE_LINE = 64;
+    static const size_t END = static_cast<size_t>(-1);
+
+    static size_t child(size_t k, size_t i);
+
+    size_t descend(RankFunction rank, const Key& key) const;
+    size_t successor(size_t j) const;
+    void layout(size_t k, size_t& rank, std::vector<size_t>& order) const;
+    void allocate();
+    void release();
+
+    size_t size_;
+    size_t blocks_;
+    SearchKernel kernel_;
+    RankFunction lower_;
+    RankFunction upper_;
+    char* storage_;
+    Key* keys_;                            // keys_[0..blocks_ * B), block order
+    std::pair<const Key, Value>* items_;   // items_[0..size_), same order
+};
+
+template<class Key, class Value>
+const size_t FrozenBTree<Key, Value>::B;
+
+/*
+  ------------------------------------------------------------
+  Begin implementations for the FrozenBTree::iterator class.
+  ------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+FrozenBTree<Key, Value>::iterator::iterator(const FrozenBTree<Key, Value>* tree, size_t curr) :
+    tree_(tree),
+    current_(curr)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value>
+FrozenBTree<Key, Value>::iterator::iterator() :
+    tree_(nullptr),
+    current_(END)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key,Value>& FrozenBTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->items_[current_];
+}
+
+template<class Key, class Value>
+const std::pair<const Key,Value>* FrozenBTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->items_[current_]);
+}
+
+/**
+* Two iterators are equal if they are at the same item; every end()
+* iterator is equal to every other one.
+*/
+template<class Key, class Value>
+bool FrozenBTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if(current_ == END){
+        return (rhs.current_ == END);
+    }
+    return (current_ == rhs.current_) && (tree_ == rhs.tree_);
+}
+
+template<class Key, class Value>
+bool FrozenBTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator& FrozenBTree<Key, Value>::iterator::operator++()
+{
+    current_ = tree_->successor(current_);
+    return (*this);
+}
+
+/*
+  ----------------------------------------------------------
+  End implementations for the FrozenBTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------
+  Begin implementations for the FrozenBTree class.
+  ------------------------------------------------
+*/
+
+/**
+* An empty snapshot.
+*/
+template<class Key, class Value>
+FrozenBTree<Key, Value>::FrozenBTree() :
+    size_(0),
+    blocks_(0),
+    kernel_(bestSearchKernel()),
+    lower_(BlockRank<Key>::lower(kernel_)),
+    upper_(BlockRank<Key>::upper(kernel_)),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+
+}
+
+/**
+* Builds the snapshot from items sorted by strictly increasing key, as
+* produced by iterating a tree. An in-order walk of the implicit tree
+* gives the slot of each item in turn.
+*/
+template<class Key, class Value>
+template<typename InputIt>
+FrozenBTree<Key, Value>::FrozenBTree(InputIt first, InputIt last) :
+    size_(0),
+    blocks_(0),
+    kernel_(bestSearchKernel()),
+    lower_(BlockRank<Key>::lower(kernel_)),
+    upper_(BlockRank<Key>::upper(kernel_)),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+    std::vector<std::pair<Key, Value> > sorted;
+    for(; first != last; ++first){
+        sorted.push_back(std::pair<Key, Value>(first->first, first->second));
+    }
+    size_ = sorted.size();
+    if(size_ == 0){
+        return;
+    }
+    blocks_ = (size_ + B - 1) / B;
+    std::vector<size_t> order(size_);
+    size_t rank = 0;
+    layout(0, rank, order);
+    allocate();
+    for(size_t j = 0; j < size_; j++){
+        new (keys_ + j) Key(sorted[order[j]].first);
+        new (items_ + j) std::pair<const Key, Value>(sorted[order[j]].first, sorted[order[j]].second);
+    }
+    for(size_t j = size_; j < blocks_ * B; j++){
+        new (keys_ + j) Key(sorted.back().first);
+    }
+}
+
+template<class Key, class Value>
+FrozenBTree<Key, Value>::FrozenBTree(const FrozenBTree<Key, Value>& other) :
+    size_(other.size_),
+    blocks_(other.blocks_),
+    kernel_(other.kernel_),
+    lower_(other.lower_),
+    upper_(other.upper_),
+    storage_(nullptr),
+    keys_(nullptr),
+    items_(nullptr)
+{
+    if(size_ == 0){
+        return;
+    }
+    allocate();
+    for(size_t j = 0; j < blocks_ * B; j++){
+        new (keys_ + j) Key(other.keys_[j]);
+    }
+    for(size_t j = 0; j < size_; j++){
+        new (items_ + j) std::pair<const Key, Value>(other.items_[j]);
+    }
+}
+
+template<class Key, class Value>
+FrozenBTree<Key, Value>::FrozenBTree(FrozenBTree<Key, Value>&& other) :
+    size_(other.size_),
+    blocks_(other.blocks_),
+    kernel_(other.kernel_),
+    lower_(other.lower_),
+    upper_(other.upper_),
+    storage_(other.storage_),
+    keys_(other.keys_),
+    items_(other.items_)
+{
+    other.size_ = 0;
+    other.blocks_ = 0;
+    other.storage_ = nullptr;
+    other.keys_ = nullptr;
+    other.items_ = nullptr;
+}
+
+template<class Key, class Value>
+FrozenBTree<Key, Value>& FrozenBTree<Key, Value>::operator=(FrozenBTree<Key, Value> other)
+{
+    std::swap(size_, other.size_);
+    std::swap(blocks_, other.blocks_);
+    std::swap(kernel_, other.kernel_);
+    std::swap(lower_, other.lower_);
+    std::swap(upper_, other.upper_);
+    std::swap(storage_, other.storage_);
+    std::swap(keys_, other.keys_);
+    std::swap(items_, other.items_);
+    return *this;
+}
+
+template<class Key, class Value>
+FrozenBTree<Key, Value>::~FrozenBTree()
+{
+    release();
+}
+
+/**
+* Gets storage for blocks_ blocks of keys and size_ items, with keys_ on
+* a cache line boundary so that each block is one aligned line.
+*/
+template<class Key, class Value>
+void FrozenBTree<Key, Value>::allocate()
+{
+    size_t keyBytes = blocks_ * B * sizeof(Key);
+    keyBytes = (keyBytes + alignof(std::pair<const Key, Value>) - 1) / alignof(std::pair<const Key, Value>) * alignof(std::pair<const Key, Value>);
+    size_t itemBytes = size_ * sizeof(std::pair<const Key, Value>);
+    storage_ = static_cast<char*>(::operator new(keyBytes + itemBytes + CACHE_LINE));
+    size_t offset = (CACHE_LINE - reinterpret_cast<uintptr_t>(storage_) % CACHE_LINE) % CACHE_LINE;
+    keys_ = reinterpret_cast<Key*>(storage_ + offset);
+    items_ = reinterpret_cast<std::pair<const Key, Value>*>(storage_ + offset + keyBytes);
+}
+
+template<class Key, class Value>
+void FrozenBTree<Key, Value>::release()
+{
+    for(size_t j = 0; j < blocks_ * B; j++){
+        keys_[j].~Key();
+    }
+    for(size_t j = 0; j < size_; j++){
+        items_[j].~Item();
+    }
+    ::operator delete(storage_);
+    size_ = 0;
+    blocks_ = 0;
+    storage_ = nullptr;
+    keys_ = nullptr;
+    items_ = nullptr;
+}
+
+/**
+* The i-th child block of block k, for i in [0, B].
+*/
+template<class Key, class Value>
+size_t FrozenBTree<Key, Value>::child(size_t k, size_t i)
+{
+    return k * (B + 1) + i + 1;
+}
+
+/**
+* Visits the implicit subtree at block k in order, recording in order[j]
+* the rank of the item that goes in slot j. Only the last block can be
+* partly filled, and it has no children.
+*/
+template<class Key, class Value>
+void FrozenBTree<Key, Value>::layout(size_t k, size_t& rank, std::vector<size_t>& order) const
+{
+    if(k >= blocks_){
+        return;
+    }
+    for(size_t i = 0; i < B; i++){
+        layout(child(k, i), rank, order);
+        if(k * B + i < size_){
+            order[k * B + i] = rank++;
+        }
+    }
+    layout(child(k, B), rank, order);
+}
+
+template<class Key, class Value>
+size_t FrozenBTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+bool FrozenBTree<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<class Key, class Value>
+SearchKernel FrozenBTree<Key, Value>::kernel() const
+{
+    return kernel_;
+}
+
+/**
+* Searches with the given kernel from now on, or the best one the CPU has
+* if it lacks that one. Key types without SIMD kernels always use the
+* scalar one.
+*/
+template<class Key, class Value>
+void FrozenBTree<Key, Value>::useKernel(SearchKernel kernel)
+{
+    kernel_ = (kernel > bestSearchKernel()) ? bestSearchKernel() : kernel;
+    lower_ = BlockRank<Key>::lower(kernel_);
+    upper_ = BlockRank<Key>::upper(kernel_);
+}
+
+/**
+* Starts at the first slot of the leftmost block.
+*/
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator FrozenBTree<Key, Value>::begin() const
+{
+    if(size_ == 0){
+        return end();
+    }
+    size_t k = 0;
+    while(child(k, 0) < blocks_){
+        k = child(k, 0);
+    }
+    return iterator(this, k * B);
+}
+
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator FrozenBTree<Key, Value>::end() const
+{
+    return iterator(this, END);
+}
+
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator FrozenBTree<Key, Value>::find(const Key& key) const
+{
+    size_t j = descend(lower_, key);
+    if((j == END) || (key < keys_[j])){
+        return end();
+    }
+    return iterator(this, j);
+}
+
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator FrozenBTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(this, descend(lower_, key));
+}
+
+template<class Key, class Value>
+typename FrozenBTree<Key, Value>::iterator FrozenBTree<Key, Value>::upper_bound(const Key& key) const
+{
+    return iterator(this, descend(upper_, key));
+}
+
+template<class Key, class Value>
+Value const & FrozenBTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Descends from the root block. rank gives the number of keys in the
+* block before the answer: the answer is at that slot if the slot holds
+* an item, else further down, in the child the rank also names. The last
+* candidate seen is the answer, END if there is none.
+*/
+template<class Key, class Value>
+size_t FrozenBTree<Key, Value>::descend(RankFunction rank, const Key& key) const
+{
+    size_t found = END;
+    size_t k = 0;
+    while(k < blocks_){
+        size_t i = rank(keys_ + k * B, key);
+        size_t j = k * B + i;
+        found = ((i < B) && (j < size_)) ? j : found;
+        k = child(k, i);
+    }
+    return found;
+}
+
+/**
+* The in-order successor of slot j: the first slot of the leftmost block
+* under the child after it, else the next slot in its block, else the
+* slot in the nearest ancestor block that follows the child it came from.
+* Returns END past the last item.
+*/
+template<class Key, class Value>
+size_t FrozenBTree<Key, Value>::successor(size_t j) const
+{
+    size_t k = j / B;
+    size_t i = j % B;
+    if(child(k, i + 1) < blocks_){
+        k = child(k, i + 1);
+        while(child(k, 0) < blocks_){
+            k = child(k, 0);
+        }
+        return k * B;
+    }
+    if((i + 1 < B) && (j + 1 < size_)){
+        return j + 1;
+    }
+    while(k != 0){
+        i = (k - 1) % (B + 1);
+        k = (k - 1) / (B + 1);
+        if(i < B){
+            return k * B + i;
+        }
+    }
+    return END;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the FrozenBTree class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+* Slab storage for the nodes of a search tree. Nodes are carved out of
+* slabs of growing size, so consecutive inserts land next to each other,
+* and freed nodes go onto a free list to be reused by the next insert.
+*
+* Slabs are reference counted. join/split/union move nodes between trees,
+* so the receiving tree adopts the slabs of the tree it took nodes from
+* and a slab is only freed once no tree refers to it. release() drops
+* all of this pool's slabs at once, which is how a tree whose nodes need
+* no destructor is cleared without visiting them.
+*
+* deallocate may be called from several threads at once (the parallel
+* set operations free nodes concurrently); everything else is single
+* threaded.
+*/
+class NodePool
+{
+public:
+    NodePool();
+
+    void* allocate(size_t size, size_t align);
+    void deallocate(void* ptr);
+    void adopt(const NodePool& other);
+    void release();
+    void swap(NodePool& other);
+
+protected:
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    static const size_t FIRST_SLAB_NODES = 64;
+    static const size_t MAX_SLAB_NODES = 4096;
+
+    std::vector<std::shared_ptr<char> > slabs_;
+    std::atomic<FreeNode*> free_;
+    char* next_;
+    char* end_;
+    size_t nodeSize_;
+    size_t align_;
+    size_t slabNodes_;
+};
+
+/**
+* An empty pool; nothing is allocated until the first node.
+*/
+inline NodePool::NodePool() :
+    free_(nullptr),
+    next_(nullptr),
+    end_(nullptr),
+    nodeSize_(0),
+    align_(1),
+    slabNodes_(FIRST_SLAB_NODES)
+{
+
+}
+
+/**
+* Returns storage for one node of the given size and alignment, taken
+* from the free list if possible and otherwise from the current slab.
+* All nodes of a pool have the same size and alignment, those of the
+* first request; slabs start on that alignment and the size is rounded
+* up to keep every node aligned, so a tree can ask for cache line
+* aligned nodes.
+*/
+inline void* NodePool::allocate(size_t size, size_t align)
+{
+    FreeNode* head = free_.load(std::memory_order_relaxed);
+    if(head != nullptr){
+        free_.store(head->next, std::memory_order_relaxed);
+        return head;
+    }
+    if(nodeSize_ == 0){
+        align = std::max(align, alignof(FreeNode));
+        nodeSize_ = (std::max(size, sizeof(FreeNode)) + align - 1) / align * align;
+        align_ = align;
+    }
+    if(next_ == end_){
+        size_t bytes = slabNodes_ * nodeSize_;
+        slabs_.push_back(std::shared_ptr<char>(new char[bytes + align_ - 1], std::default_delete<char[]>()));
+        next_ = slabs_.back().get();
+        next_ += (align_ - reinterpret_cast<uintptr_t>(next_) % align_) % align_;
+        end_ = next_ + bytes;
+        if(slabNodes_ < MAX_SLAB_NODES){
+            slabNodes_ *= 2;
+        }
+    }
+    void* curr = next_;
+    next_ += nodeSize_;
+    return curr;
+}
+
+/**
+* Puts a node's storage on the free list. The node must already be
+* destroyed and must live in a slab this pool refers to.
+*/
+inline void NodePool::deallocate(void* ptr)
+{
+    FreeNode* curr = static_cast<FreeNode*>(ptr);
+    curr->next = free_.load(std::memory_order_relaxed);
+    while(!free_.compare_exchange_weak(curr->next, curr,
+                                       std::memory_order_release, std::memory_order_relaxed)){
+    }
+}
+
+/**
+* Takes a reference to every slab of other that this pool does not
+* already refer to, so nodes moved over from other's tree stay valid
+* for as long as this pool does. other keeps its own references.
+*/
+inline void NodePool::adopt(const NodePool& other)
+{
+    if(&other == this){
+        return;
+    }
+    size_t count = slabs_.size();
+    for(size_t i = 0; i < other.slabs_.size(); i++){
+        bool found = false;
+        for(size_t j = 0; j < count; j++){
+            if(slabs_[j] == other.slabs_[i]){
+                found = true;
+                break;
+            }
+        }
+        if(!found){
+            slabs_.push_back(other.slabs_[i]);
+        }
+    }
+    if(nodeSize_ == 0){
+        nodeSize_ = other.nodeSize_;
+        align_ = other.align_;
+    }
+}
+
+/**
+* Drops every slab reference and the free list. Slabs no other pool
+* refers to are freed; any node still living in them is gone with them.
+*/
+inline void NodePool::release()
+{
+    slabs_.clear();
+    free_.store(nullptr, std::memory_order_relaxed);
+    next_ = nullptr;
+    end_ = nullptr;
+    slabNodes_ = FIRST_SLAB_NODES;
+}
+
+/**
+* Exchanges the slabs, free list and slab cursor of two pools in O(1),
+* so a tree can hand all of its nodes to another one.
+*/
+inline void NodePool::swap(NodePool& other)
+{
+    slabs_.swap(other.slabs_);
+    FreeNode* head = free_.load(std::memory_order_relaxed);
+    free_.store(other.free_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other.free_.store(head, std::memory_order_relaxed);
+    std::swap(next_, other.next_);
+    std::swap(end_, other.end_);
+    std::swap(nodeSize_, other.nodeSize_);
+    std::swap(align_, other.align_);
+    std::swap(slabNodes_, other.slabNodes_);
+}
+
+#endif
@@ -0,0 +1,961 @@
+#ifndef PERSISTENTAVLBST_H
+#define PERSISTENTAVLBST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+/**
+* A node of a PersistentAVLTree: the item, two child pointers, the
+* balance and a count of the links to it, from parent nodes and from tree
+* roots. There is no parent pointer, since a node shared between versions
+* has a parent in each of them.
+*/
+template <typename Key, typename Value>
+class PersistentAVLNode
+{
+public:
+    // Constructor/destructor.
+    explicit PersistentAVLNode(const std::pair<const Key, Value>& item);
+    ~PersistentAVLNode();
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const Value& getValue() const;
+    void setValue(const Value& value);
+
+    PersistentAVLNode<Key, Value>* getLeft() const;
+    PersistentAVLNode<Key, Value>* getRight() const;
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+
+protected:
+    // The tree rewires children through pointers to these links.
+    template<typename K, typename V, typename C> friend class PersistentAVLTree;
+
+    std::pair<const Key, Value> item_;
+    PersistentAVLNode<Key, Value>* left_;
+    PersistentAVLNode<Key, Value>* right_;
+    std::atomic<uint32_t> refs_;
+    int8_t balance_;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the PersistentAVLNode class.
+  -----------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node is a leaf with balance 0 and the
+* one link that the caller is about to make to it.
+*/
+template<class Key, class Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(const std::pair<const Key, Value>& item) :
+    item_(item),
+    left_(nullptr),
+    right_(nullptr),
+    refs_(1),
+    balance_(0)
+{
+
+}
+
+/**
+* A destructor which does nothing; the tree drops the links to the
+* children.
+*/
+template<class Key, class Value>
+PersistentAVLNode<Key, Value>::~PersistentAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& PersistentAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& PersistentAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const Value& PersistentAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void PersistentAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<class Key, class Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<class Key, class Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<class Key, class Value>
+int8_t PersistentAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void PersistentAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the PersistentAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* An AVL tree whose versions share structure. snapshot() (or a plain
+* copy) is O(1): it takes another link to the root, and from then on the
+* two trees are independent versions that share every node neither has
+* changed since.
+*
+* A node with more than one link to it is immutable. insert and remove
+* take ownership of the nodes on their path from the root down, copying
+* any shared one (which takes a link to each of its children, so they
+* become shared in turn). That is O(log n) new nodes per write while a
+* snapshot holds the old path, and none at all between snapshots, when
+* every node on the path has a single link and is changed in place as in
+* StackAVLTree. Rotations on the way back up make the sibling they pull
+* in owned the same way. A node is freed when its last link goes, which
+* drops its links to its children in turn.
+*
+* Link counts are atomic, so a snapshot can be handed to another thread
+* and read and destroyed there while this tree keeps changing. Each tree
+* object is still single threaded, and snapshot() is a read of this tree:
+* take it on the writing thread, or under whatever lock the writes hold.
+* Nodes come from the heap rather than a NodePool, since they outlive the
+* tree that made them and are freed by whichever version drops them last.
+*
+* Like StackAVLTree, there are no parent pointers and iterators carry the
+* stack of ancestors. Items are read-only through the iterators, since a
+* node may belong to other versions; insert overwrites a value. A write
+* invalidates this tree's iterators as usual; iterate a snapshot to keep
+* a stable view across writes.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class PersistentAVLTree
+{
+protected:
+    typedef PersistentAVLNode<Key, Value> PNode;
+
+public:
+    static const int MAX_HEIGHT = 64;
+
+    explicit PersistentAVLTree(const Compare& comp = Compare());
+    PersistentAVLTree(const PersistentAVLTree<Key, Value, Compare>& other);
+    PersistentAVLTree(PersistentAVLTree<Key, Value, Compare>&& other);
+    PersistentAVLTree<Key, Value, Compare>& operator=(PersistentAVLTree<Key, Value, Compare> other);
+    ~PersistentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    PersistentAVLTree<Key, Value, Compare> snapshot() const;
+    size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+    size_t sharedNodes(const PersistentAVLTree<Key, Value, Compare>& other) const;
+
+    /**
+    * A read-only iterator over the tree in key order. It holds the
+    * current node on top of the ancestors whose left subtree it is in,
+    * which are the nodes still to be visited after it.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        void push(const PNode* curr);
+        void pushLeft(const PNode* curr);
+        const PNode* current() const;
+
+        const PNode* stack_[MAX_HEIGHT];
+        int depth_;
+    };
+
+    /**
+    * A [first, last) pair of iterators that can be walked with a
+    * range-based for loop; returned by range().
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    PNode* internalFind(const Key& key) const;
+    int subheight(const PNode* curr) const;
+    static size_t subtreeNodes(const PNode* curr);
+    static void collectNodes(const PNode* curr, std::unordered_set<const PNode*>& nodes);
+    static size_t countShared(const PNode* curr, const std::unordered_set<const PNode*>& nodes);
+
+    PNode* createNode(const std::pair<const Key, Value>& item);
+    void destroyNode(PNode* curr);
+    static PNode* retain(PNode* curr);
+    static void release(PNode* curr);
+    PNode* own(PNode** link);
+    PNode* copyNode(PNode** link);
+
+    PNode* rebalance(PNode* prev, int8_t balance);
+    PNode* insertLeft(PNode* pare);
+    PNode* insertRight(PNode* pare);
+
+protected:
+    Compare comp_;
+    PNode* root_;
+    size_t size_;
+};
+
+template<class Key, class Value, class Compare>
+const int PersistentAVLTree<Key, Value, Compare>::MAX_HEIGHT;
+
+/*
+  ----------------------------------------------------------------
+  Begin implementations for the PersistentAVLTree::iterator class.
+  ----------------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::iterator::push(const PNode* curr)
+{
+    stack_[depth_++] = curr;
+}
+
+/**
+* Pushes curr and its chain of left descendants, ending on the smallest
+* node of curr's subtree.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::iterator::pushLeft(const PNode* curr)
+{
+    while(curr != nullptr){
+        push(curr);
+        curr = curr->getLeft();
+    }
+}
+
+/**
+* The node the iterator is at, NULL for end().
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::iterator::current() const
+{
+    if(depth_ == 0){
+        return nullptr;
+    }
+    return stack_[depth_ - 1];
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>& PersistentAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>* PersistentAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+/**
+* Two iterators are equal if they are at the same node.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* The next node is the smallest one in the right subtree if there is one,
+* and otherwise the nearest ancestor left on the stack.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator& PersistentAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    const PNode* curr = stack_[--depth_];
+    pushLeft(curr->getRight());
+    return (*this);
+}
+
+/*
+  --------------------------------------------------------------
+  End implementations for the PersistentAVLTree::iterator class.
+  --------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::iterator_range::end() const
+{
+    return last_;
+}
+
+/**
+* Returns true if the range holds no items.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator_range::empty() const
+{
+    return first_ == last_;
+}
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  ------------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const Compare& comp) :
+    comp_(comp),
+    root_(nullptr),
+    size_(0)
+{
+
+}
+
+/**
+* Copy constructor; takes a link to other's root, in O(1).
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const PersistentAVLTree<Key, Value, Compare>& other) :
+    comp_(other.comp_),
+    root_(retain(other.root_)),
+    size_(other.size_)
+{
+
+}
+
+/**
+* Move constructor; other is left empty.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(PersistentAVLTree<Key, Value, Compare>&& other) :
+    comp_(other.comp_),
+    root_(other.root_),
+    size_(other.size_)
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+}
+
+/**
+* Copy and move assignment, through the by-value parameter.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>& PersistentAVLTree<Key, Value, Compare>::operator=(PersistentAVLTree<Key, Value, Compare> other)
+{
+    std::swap(comp_, other.comp_);
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::~PersistentAVLTree()
+{
+    clear();
+}
+
+/**
+* Inserts keyValuePair, or overwrites the value if the key is already in
+* the tree. The descent takes ownership of every node it passes and
+* records the link to it, making one comparison per level: it runs to
+* the bottom while noting the last node it went right from, which is
+* the only one that can hold the key. An overwrite under a snapshot so
+* also copies the few nodes below the one it changes. The retrace is
+* StackAVLTree's.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    PNode** links[MAX_HEIGHT + 1];
+    int depth = 0;
+    int floor = -1;
+    PNode** link = &root_;
+    while((*link) != nullptr){
+        PNode* curr = own(link);
+        bool left = comp_(keyValuePair.first, curr->getKey());
+        floor = left ? floor : depth;
+        links[depth++] = link;
+        link = left ? &(curr->left_) : &(curr->right_);
+    }
+    if((floor >= 0) && !comp_((*links[floor])->getKey(), keyValuePair.first)){
+        (*links[floor])->setValue(keyValuePair.second);
+        return;
+    }
+    *link = createNode(keyValuePair);
+    links[depth] = link;
+    size_++;
+
+    for(int i = depth - 1; i >= 0; i--){
+        PNode* curr = *links[i];
+        int8_t balance = curr->getBalance() + ((links[i + 1] == &(curr->left_)) ? -1 : 1);
+        if(balance == 0){
+            curr->setBalance(0);
+            return;
+        }
+        if((balance < -1) || (balance > 1)){
+            *links[i] = rebalance(curr, balance);
+            return;
+        }
+        curr->setBalance(balance);
+    }
+}
+
+/**
+* Removes the item with the given key, if any. The descent is insert's,
+* to the bottom with the last node it went right from as the candidate;
+* past that node it goes right once and then left, which is the path to
+* its successor. It takes nothing over and records each turn as a bit,
+* so nothing is copied when the key is not in the tree. Otherwise a
+* second pass replays the turns over the nodes just read, taking
+* ownership and recording the links, and the node is replaced by its
+* successor, the mirror image of StackAVLTree::remove.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    uint64_t turns = 0;
+    int depth = 0;
+    int found = -1;
+    const PNode* floor = nullptr;
+    for(const PNode* curr = root_; curr != nullptr; depth++){
+        bool left = comp_(key, curr->getKey());
+        turns |= static_cast<uint64_t>(left) << depth;
+        found = left ? found : depth;
+        floor = left ? floor : curr;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    if((floor == nullptr) || comp_(floor->getKey(), key)){
+        return;
+    }
+
+    PNode** links[MAX_HEIGHT + 1];
+    PNode** link = &root_;
+    for(int i = 0; i < depth; i++){
+        PNode* curr = own(link);
+        links[i] = link;
+        link = ((turns >> i) & 1) ? &(curr->left_) : &(curr->right_);
+    }
+    PNode* curr = *links[found];
+    if(found == depth - 1){
+        // No right child, so the left one (if any) takes its place.
+        *links[found] = curr->getLeft();
+        link = links[found];
+        depth = found;
+    }
+    else{
+        PNode* succ = *links[depth - 1];
+        link = links[depth - 1];
+        *link = succ->getRight();
+        succ->left_ = curr->getLeft();
+        succ->right_ = curr->getRight();
+        succ->setBalance(curr->getBalance());
+        *links[found] = succ;
+        // Links into curr now live in succ.
+        if(link == &(curr->right_)){
+            link = &(succ->right_);
+        }
+        if(links[found + 1] == &(curr->right_)){
+            links[found + 1] = &(succ->right_);
+        }
+        depth--;
+    }
+    // curr's links to its children have moved, so it goes without release.
+    destroyNode(curr);
+    links[depth] = link;
+    size_--;
+
+    for(int i = depth - 1; i >= 0; i--){
+        PNode* prev = *links[i];
+        int8_t balance = prev->getBalance() + ((links[i + 1] == &(prev->left_)) ? 1 : -1);
+        if((balance == -1) || (balance == 1)){
+            prev->setBalance(balance);
+            return;
+        }
+        if(balance == 0){
+            prev->setBalance(0);
+            continue;
+        }
+        PNode* heavy = (balance < 0) ? prev->getLeft() : prev->getRight();
+        bool evenChild = (heavy->getBalance() == 0);
+        *links[i] = rebalance(prev, balance);
+        if(evenChild){
+            return;
+        }
+    }
+}
+
+/**
+* Removes every item from this version; nodes still in other versions
+* stay.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::clear()
+{
+    release(root_);
+    root_ = nullptr;
+    size_ = 0;
+}
+
+/**
+* Returns a version of the tree as it is now, in O(1). It is unaffected
+* by later writes to this tree, and writes to it leave this tree alone.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare> PersistentAVLTree<Key, Value, Compare>::snapshot() const
+{
+    return PersistentAVLTree<Key, Value, Compare>(*this);
+}
+
+template<class Key, class Value, class Compare>
+size_t PersistentAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return subheight(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at curr, or -1 if any subtree in it
+* is out of balance.
+*/
+template<class Key, class Value, class Compare>
+int PersistentAVLTree<Key, Value, Compare>::subheight(const PNode* curr) const
+{
+    if(curr == nullptr){
+        return 0;
+    }
+    int left = subheight(curr->getLeft());
+    int right = subheight(curr->getRight());
+    if((left == -1) || (right == -1) || (left - right > 1) || (right - left > 1)){
+        return -1;
+    }
+    return ((left > right) ? left : right) + 1;
+}
+
+/**
+* Returns how many of this tree's nodes are also nodes of other, in O(n).
+* For two versions of one history, size() minus this is the number of
+* nodes that keeping both costs over keeping other alone.
+*/
+template<class Key, class Value, class Compare>
+size_t PersistentAVLTree<Key, Value, Compare>::sharedNodes(const PersistentAVLTree<Key, Value, Compare>& other) const
+{
+    std::unordered_set<const PNode*> nodes;
+    collectNodes(other.root_, nodes);
+    return countShared(root_, nodes);
+}
+
+template<class Key, class Value, class Compare>
+size_t PersistentAVLTree<Key, Value, Compare>::subtreeNodes(const PNode* curr)
+{
+    if(curr == nullptr){
+        return 0;
+    }
+    return subtreeNodes(curr->getLeft()) + subtreeNodes(curr->getRight()) + 1;
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::collectNodes(const PNode* curr, std::unordered_set<const PNode*>& nodes)
+{
+    while(curr != nullptr){
+        nodes.insert(curr);
+        collectNodes(curr->getLeft(), nodes);
+        curr = curr->getRight();
+    }
+}
+
+/**
+* The children of a shared node are shared too, so the first shared node
+* on each path accounts for its whole subtree.
+*/
+template<class Key, class Value, class Compare>
+size_t PersistentAVLTree<Key, Value, Compare>::countShared(const PNode* curr, const std::unordered_set<const PNode*>& nodes)
+{
+    if(curr == nullptr){
+        return 0;
+    }
+    if(nodes.count(curr) != 0){
+        return subtreeNodes(curr);
+    }
+    return countShared(curr->getLeft(), nodes) + countShared(curr->getRight(), nodes);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it;
+    it.pushLeft(root_);
+    return it;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* The lower bound of key, if its key is not greater than key; one
+* comparison per level and one more at the end.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if((it != end()) && comp_(key, it->first)){
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+* As in StackAVLTree, every node stacked is such an item, each smaller
+* than the last, and the step writes every node into the next slot and
+* keeps it only when going left, so as not to branch on the comparison.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    iterator it;
+    const PNode* curr = root_;
+    while(curr != nullptr){
+        bool left = !comp_(curr->getKey(), key);
+        it.stack_[it.depth_] = curr;
+        it.depth_ += left;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator PersistentAVLTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    iterator it;
+    const PNode* curr = root_;
+    while(curr != nullptr){
+        bool left = comp_(key, curr->getKey());
+        it.stack_[it.depth_] = curr;
+        it.depth_ += left;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    return it;
+}
+
+template<class Key, class Value, class Compare>
+std::pair<typename PersistentAVLTree<Key, Value, Compare>::iterator, typename PersistentAVLTree<Key, Value, Compare>::iterator>
+PersistentAVLTree<Key, Value, Compare>::equal_range(const Key& key) const
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if((first != end()) && !comp_(key, first->first)){
+        ++last;
+    }
+    return std::make_pair(first, last);
+}
+
+/**
+* Returns the items with lo <= key < hi; empty if hi <= lo.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator_range PersistentAVLTree<Key, Value, Compare>::range(const Key& lo, const Key& hi) const
+{
+    if(!comp_(lo, hi)){
+        return iterator_range(end(), end());
+    }
+    return iterator_range(lower_bound(lo), lower_bound(hi));
+}
+
+template<class Key, class Value, class Compare>
+Value const & PersistentAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    PNode* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* Returns the node holding key, or NULL: only the lower bound of key can
+* be equal to it.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::internalFind(const Key& key) const
+{
+    PNode* curr = root_;
+    PNode* bound = nullptr;
+    while(curr != nullptr){
+        bool left = !comp_(curr->getKey(), key);
+        bound = left ? curr : bound;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    if((bound == nullptr) || comp_(key, bound->getKey())){
+        return nullptr;
+    }
+    return bound;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::createNode(const std::pair<const Key, Value>& item)
+{
+    return new PNode(item);
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::destroyNode(PNode* curr)
+{
+    delete curr;
+}
+
+/**
+* Takes another link to curr, if any, and returns it.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::retain(PNode* curr)
+{
+    if(curr != nullptr){
+        curr->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return curr;
+}
+
+/**
+* Drops a link to curr, freeing it if that was the last one and dropping
+* its own links in turn. Recursing on the left and looping on the right
+* bounds the depth by the height of the tree.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::release(PNode* curr)
+{
+    while((curr != nullptr) && (curr->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)){
+        release(curr->getLeft());
+        PNode* right = curr->getRight();
+        delete curr;
+        curr = right;
+    }
+}
+
+/**
+* Makes the node at *link one that only this tree links to, so that it
+* can be changed in place, and returns it. The caller owns the node
+* holding link (or link is root_), so a count of one means no other
+* version can reach the node, nor take a link to it meanwhile. The copy
+* is kept out of line so that this check inlines into the descents.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::own(PNode** link)
+{
+    PNode* curr = *link;
+    if(curr->refs_.load(std::memory_order_acquire) == 1){
+        return curr;
+    }
+    return copyNode(link);
+}
+
+/**
+* Replaces the shared node at *link by a copy that links to the same
+* children, and returns the copy.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::copyNode(PNode** link)
+{
+    PNode* curr = *link;
+    PNode* copy = createNode(curr->getItem());
+    copy->left_ = retain(curr->getLeft());
+    copy->right_ = retain(curr->getRight());
+    copy->setBalance(curr->getBalance());
+    *link = copy;
+    release(curr);
+    return copy;
+}
+
+/**
+ * Rotates the subtree rooted at prev, whose balance is -2 or 2, back into
+ * AVL shape, as StackAVLTree::rebalance. prev is owned, and so is the
+ * heavy child after an insert; after a remove the heavy child is off the
+ * descent path, so the nodes that rotate up are made owned first.
+ */
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::rebalance(PNode* prev, int8_t balance)
+{
+    if(balance < 0){
+        PNode* curr = own(&(prev->left_));
+        if(curr->getBalance() <= 0){
+            insertLeft(prev);
+            if(curr->getBalance() == 0){
+                prev->setBalance(-1);
+                curr->setBalance(1);
+            }
+            else{
+                prev->setBalance(0);
+                curr->setBalance(0);
+            }
+            return curr;
+        }
+        PNode* next = own(&(curr->right_));
+        prev->left_ = insertRight(curr);
+        insertLeft(prev);
+        curr->setBalance((next->getBalance() > 0) ? -1 : 0);
+        prev->setBalance((next->getBalance() < 0) ? 1 : 0);
+        next->setBalance(0);
+        return next;
+    }
+    PNode* curr = own(&(prev->right_));
+    if(curr->getBalance() >= 0){
+        insertRight(prev);
+        if(curr->getBalance() == 0){
+            prev->setBalance(1);
+            curr->setBalance(-1);
+        }
+        else{
+            prev->setBalance(0);
+            curr->setBalance(0);
+        }
+        return curr;
+    }
+    PNode* next = own(&(curr->left_));
+    prev->right_ = insertLeft(curr);
+    insertRight(prev);
+    curr->setBalance((next->getBalance() < 0) ? 1 : 0);
+    prev->setBalance((next->getBalance() > 0) ? -1 : 0);
+    next->setBalance(0);
+    return next;
+}
+
+/**
+* Rotates right around pare and returns the new root of the subtree. The
+* links only move, so no count changes.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::insertLeft(PNode* pare)
+{
+    PNode* prev = pare->getLeft();
+    pare->left_ = prev->getRight();
+    prev->right_ = pare;
+    return prev;
+}
+
+/**
+* Rotates left around pare and returns the new root of the subtree.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::PNode* PersistentAVLTree<Key, Value, Compare>::insertRight(PNode* pare)
+{
+    PNode* prev = pare->getRight();
+    pare->right_ = prev->getLeft();
+    prev->left_ = pare;
+    return prev;
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PersistentAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
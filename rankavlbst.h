@@ -0,0 +1,356 @@
+#ifndef RANKAVLBST_H
+#define RANKAVLBST_H
+
+#include <cstddef>
+#include "avlbst.h"
+
+/**
+* An AVL node that also records how many nodes are in its subtree. Only
+* trees that want order statistics (RankedAVLTree) use this node, so
+* plain AVL trees do not pay for the extra field.
+*/
+template <typename Key, typename Value>
+class RankedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    RankedAVLNode(const Key& key, const Value& value, RankedAVLNode<Key, Value>* parent);
+    template<typename... Args>
+    RankedAVLNode(RankedAVLNode<Key, Value>* parent, Args&&... args);
+    ~RankedAVLNode();
+
+    // Getter/setter for the number of nodes in this subtree.
+    size_t getSize() const;
+    void setSize(size_t size);
+
+    // Redefined for the same reason as in AVLNode.
+    RankedAVLNode<Key, Value>* getParent() const;
+    RankedAVLNode<Key, Value>* getLeft() const;
+    RankedAVLNode<Key, Value>* getRight() const;
+
+protected:
+    size_t size_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RankedAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node is a subtree of one.
+*/
+template<class Key, class Value>
+RankedAVLNode<Key, Value>::RankedAVLNode(const Key& key, const Value& value, RankedAVLNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(key, value, parent), size_(1)
+{
+
+}
+
+/**
+* Constructs the item in place; see Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+RankedAVLNode<Key, Value>::RankedAVLNode(RankedAVLNode<Key, Value> *parent, Args&&... args) :
+    AVLNode<Key, Value>(parent, std::forward<Args>(args)...), size_(1)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RankedAVLNode<Key, Value>::~RankedAVLNode()
+{
+
+}
+
+/**
+* A getter for the subtree size of a RankedAVLNode.
+*/
+template<class Key, class Value>
+size_t RankedAVLNode<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the subtree size of a RankedAVLNode.
+*/
+template<class Key, class Value>
+void RankedAVLNode<Key, Value>::setSize(size_t size)
+{
+    size_ = size;
+}
+
+/**
+* Redefined so that callers get a RankedAVLNode back without a cast.
+*/
+template<class Key, class Value>
+RankedAVLNode<Key, Value> *RankedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<RankedAVLNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value>
+RankedAVLNode<Key, Value> *RankedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<RankedAVLNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value>
+RankedAVLNode<Key, Value> *RankedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<RankedAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RankedAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree with order statistics. Every node knows the size of its
+* subtree, which the insert, remove, rotation, swap and join paths keep
+* up to date through the updateNode/updatePath hooks. That makes
+* select, rank and count_range O(log n).
+*/
+template <class Key, class Value>
+class RankedAVLTree : public AVLTree<Key, Value, std::less<Key>, RankedAVLTree<Key, Value> >
+{
+    typedef AVLTree<Key, Value, std::less<Key>, RankedAVLTree<Key, Value> > Base;
+    friend class BinarySearchTree<Key, Value>;
+    friend class AVLTree<Key, Value, std::less<Key>, RankedAVLTree<Key, Value> >;
+
+public:
+    RankedAVLTree();
+    template<typename ForwardIt>
+    RankedAVLTree(ForwardIt first, ForwardIt last);
+    RankedAVLTree(const RankedAVLTree<Key, Value>& other);
+    RankedAVLTree(RankedAVLTree<Key, Value>&& other);
+    virtual ~RankedAVLTree();
+    RankedAVLTree<Key, Value>& operator=(RankedAVLTree<Key, Value> other);
+    RankedAVLTree<Key, Value> clone(unsigned int threads = 1) const;
+
+    size_t size() const;
+    typename BinarySearchTree<Key, Value>::iterator select(size_t k) const;
+    size_t rank(const Key& key) const;
+    size_t count_range(const Key& lo, const Key& hi) const;
+
+protected:
+    void nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    Node<Key, Value>* cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent);
+    void destroyNode(Node<Key, Value>* curr);
+    void updateNode(Node<Key, Value>* curr);
+    void updatePath(Node<Key, Value>* curr);
+    static size_t subtreeSize(Node<Key, Value>* curr);
+};
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value>
+RankedAVLTree<Key, Value>::RankedAVLTree() : Base()
+{
+
+}
+
+/**
+* Builds the tree from a range sorted by strictly increasing key, in O(n).
+*/
+template<class Key, class Value>
+template<typename ForwardIt>
+RankedAVLTree<Key, Value>::RankedAVLTree(ForwardIt first, ForwardIt last) : Base()
+{
+    this->assign(first, last);
+}
+
+/**
+* A deep copy of other with the same shape, made once this tree's hooks
+* exist.
+*/
+template<class Key, class Value>
+RankedAVLTree<Key, Value>::RankedAVLTree(const RankedAVLTree<Key, Value>& other) : Base()
+{
+    Base::cloneWith(*this, other, 1);
+}
+
+/**
+* Takes over other's nodes in O(1), leaving other empty.
+*/
+template<class Key, class Value>
+RankedAVLTree<Key, Value>::RankedAVLTree(RankedAVLTree<Key, Value>&& other) : Base(std::move(other))
+{
+
+}
+
+/**
+* Frees the nodes while this tree's hooks are still around.
+*/
+template<class Key, class Value>
+RankedAVLTree<Key, Value>::~RankedAVLTree()
+{
+    this->clear();
+}
+
+template<class Key, class Value>
+RankedAVLTree<Key, Value>& RankedAVLTree<Key, Value>::operator=(RankedAVLTree<Key, Value> other)
+{
+    this->swap(other);
+    return *this;
+}
+
+/**
+* Returns a copy of the tree, as AVLTree::clone.
+*/
+template<class Key, class Value>
+RankedAVLTree<Key, Value> RankedAVLTree<Key, Value>::clone(unsigned int threads) const
+{
+    RankedAVLTree<Key, Value> copy;
+    Base::cloneWith(copy, *this, threads);
+    return copy;
+}
+
+/**
+* Returns the number of items in the tree, in O(1).
+*/
+template<class Key, class Value>
+size_t RankedAVLTree<Key, Value>::size() const
+{
+    return subtreeSize(this->root_);
+}
+
+/**
+* Returns an iterator to the k-th smallest item (counting from 0), or
+* end() if the tree holds k or fewer items.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator RankedAVLTree<Key, Value>::select(size_t k) const
+{
+    RankedAVLNode<Key, Value>* curr = static_cast<RankedAVLNode<Key, Value>*>(this->root_);
+    while(curr != nullptr){
+        size_t leftSize = subtreeSize(curr->getLeft());
+        if(k < leftSize){
+            curr = curr->getLeft();
+        }
+        else if(k == leftSize){
+            break;
+        }
+        else{
+            k -= leftSize + 1;
+            curr = curr->getRight();
+        }
+    }
+    return this->makeIterator(curr);
+}
+
+/**
+* Returns how many keys in the tree are smaller than key. key does not
+* have to be in the tree.
+*/
+template<class Key, class Value>
+size_t RankedAVLTree<Key, Value>::rank(const Key& key) const
+{
+    size_t count = 0;
+    RankedAVLNode<Key, Value>* curr = static_cast<RankedAVLNode<Key, Value>*>(this->root_);
+    while(curr != nullptr){
+        if((curr->getKey()) < key){
+            count += subtreeSize(curr->getLeft()) + 1;
+            curr = curr->getRight();
+        }
+        else{
+            curr = curr->getLeft();
+        }
+    }
+    return count;
+}
+
+/**
+* Returns how many keys k in the tree satisfy lo <= k < hi.
+*/
+template<class Key, class Value>
+size_t RankedAVLTree<Key, Value>::count_range(const Key& lo, const Key& hi) const
+{
+    if(!(lo < hi)){
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+/**
+* Sizes describe positions in the tree, so they are swapped back along
+* with the balances.
+*/
+template<class Key, class Value>
+void RankedAVLTree<Key, Value>::nodeSwap(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    Base::nodeSwap(n1, n2);
+    RankedAVLNode<Key, Value>* r1 = static_cast<RankedAVLNode<Key, Value>*>(n1);
+    RankedAVLNode<Key, Value>* r2 = static_cast<RankedAVLNode<Key, Value>*>(n2);
+    size_t tempS = r1->getSize();
+    r1->setSize(r2->getSize());
+    r2->setSize(tempS);
+}
+
+template<class Key, class Value>
+template<typename... Args>
+Node<Key, Value>* RankedAVLTree<Key, Value>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (this->template allocateNode<RankedAVLNode<Key, Value> >()) RankedAVLNode<Key, Value>(static_cast<RankedAVLNode<Key, Value>*>(parent), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* RankedAVLTree<Key, Value>::cloneNode(Node<Key, Value>* src, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* curr = Base::cloneNode(src, parent);
+    static_cast<RankedAVLNode<Key, Value>*>(curr)->setSize(subtreeSize(src));
+    return curr;
+}
+
+template<class Key, class Value>
+void RankedAVLTree<Key, Value>::destroyNode(Node<Key, Value>* curr)
+{
+    this->freeNode(static_cast<RankedAVLNode<Key, Value>*>(curr));
+}
+
+template<class Key, class Value>
+void RankedAVLTree<Key, Value>::updateNode(Node<Key, Value>* curr)
+{
+    static_cast<RankedAVLNode<Key, Value>*>(curr)->setSize(
+        subtreeSize(curr->getLeft()) + subtreeSize(curr->getRight()) + 1);
+}
+
+template<class Key, class Value>
+void RankedAVLTree<Key, Value>::updatePath(Node<Key, Value>* curr)
+{
+    while(curr != nullptr){
+        updateNode(curr);
+        curr = curr->getParent();
+    }
+}
+
+/**
+* The size of the subtree at curr, 0 for an empty one.
+*/
+template<class Key, class Value>
+size_t RankedAVLTree<Key, Value>::subtreeSize(Node<Key, Value>* curr)
+{
+    if(curr == nullptr){
+        return 0;
+    }
+    return static_cast<RankedAVLNode<Key, Value>*>(curr)->getSize();
+}
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef SIMDSEARCH_H
+#define SIMDSEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BST_SIMD_X86
+#define BST_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define BST_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define BST_TARGET_SSE42
+#define BST_TARGET_AVX2
+#endif
+
+/**
+* The instruction sets the block search kernels come in, from slowest
+* to fastest.
+*/
+enum SearchKernel
+{
+    SCALAR_KERNEL,
+    SSE42_KERNEL,
+    AVX2_KERNEL
+};
+
+/**
+* Returns the fastest kernel this CPU supports, as reported by CPUID.
+* Checked once; the kernels are compiled for their instruction set with
+* target attributes, so no -m flags are needed and the same binary runs
+* anywhere.
+*/
+inline SearchKernel bestSearchKernel()
+{
+#ifdef BST_SIMD_X86
+    static const SearchKernel best = []{
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return AVX2_KERNEL;
+        }
+        if(__builtin_cpu_supports("sse4.2")){
+            return SSE42_KERNEL;
+        }
+        return SCALAR_KERNEL;
+    }();
+    return best;
+#else
+    return SCALAR_KERNEL;
+#endif
+}
+
+/**
+* Ranks a key against a block of WIDTH sorted keys: rankLower counts the
+* keys less than key, rankUpper the keys not greater than it. A block is
+* one cache line for the integral specializations below. This generic
+* version, for any Key with operator<, only has a scalar kernel.
+*/
+template <typename Key>
+struct BlockRank
+{
+    static const size_t WIDTH = (sizeof(Key) * 2 <= 64) ? 64 / sizeof(Key) : 2;
+    typedef size_t (*Function)(const Key* block, const Key& key);
+
+    static size_t scalarLower(const Key* block, const Key& key);
+    static size_t scalarUpper(const Key* block, const Key& key);
+    static Function lower(SearchKernel kernel);
+    static Function upper(SearchKernel kernel);
+};
+
+template<typename Key>
+const size_t BlockRank<Key>::WIDTH;
+
+/**
+* The scalar kernel: a fixed-length loop without early exit, so there is
+* no branch on the comparisons.
+*/
+template<typename Key>
+size_t BlockRank<Key>::scalarLower(const Key* block, const Key& key)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < WIDTH; i++){
+        count += (block[i] < key);
+    }
+    return count;
+}
+
+template<typename Key>
+size_t BlockRank<Key>::scalarUpper(const Key* block, const Key& key)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < WIDTH; i++){
+        count += !(key < block[i]);
+    }
+    return count;
+}
+
+template<typename Key>
+typename BlockRank<Key>::Function BlockRank<Key>::lower(SearchKernel kernel)
+{
+    return &scalarLower;
+}
+
+template<typename Key>
+typename BlockRank<Key>::Function BlockRank<Key>::upper(SearchKernel kernel)
+{
+    return &scalarUpper;
+}
+
+/*
+  -----------------------------------------------
+  Begin SIMD kernels.
+
+  Each compares key against a whole 64-byte block with signed
+  greater-than: 16 32-bit keys in four SSE or two AVX2 comparisons, or
+  8 64-bit keys in four SSE4.2 or two AVX2 comparisons. The comparison
+  masks are gathered with movemask and counted with popcount. Unsigned
+  keys are handled by flipping the sign bit of both sides, which maps
+  unsigned order onto signed order. Upper is the count of keys that are
+  not greater than key, i.e. WIDTH minus the keys greater than it.
+  -----------------------------------------------
+*/
+
+#ifdef BST_SIMD_X86
+
+template<bool Upper>
+BST_TARGET_SSE42
+inline size_t rankBlock32Sse42(const int32_t* block, int32_t key, int32_t flip)
+{
+    __m128i k = _mm_set1_epi32(key ^ flip);
+    __m128i f = _mm_set1_epi32(flip);
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), f);
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 4)), f);
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 8)), f);
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 12)), f);
+    __m128i m0 = Upper ? _mm_cmpgt_epi32(x0, k) : _mm_cmpgt_epi32(k, x0);
+    __m128i m1 = Upper ? _mm_cmpgt_epi32(x1, k) : _mm_cmpgt_epi32(k, x1);
+    __m128i m2 = Upper ? _mm_cmpgt_epi32(x2, k) : _mm_cmpgt_epi32(k, x2);
+    __m128i m3 = Upper ? _mm_cmpgt_epi32(x3, k) : _mm_cmpgt_epi32(k, x3);
+    __m128i packed = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+    size_t count = __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(packed)));
+    return Upper ? 16 - count : count;
+}
+
+template<bool Upper>
+BST_TARGET_AVX2
+inline size_t rankBlock32Avx2(const int32_t* block, int32_t key, int32_t flip)
+{
+    __m256i k = _mm256_set1_epi32(key ^ flip);
+    __m256i f = _mm256_set1_epi32(flip);
+    __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)), f);
+    __m256i x1 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 8)), f);
+    __m256i m0 = Upper ? _mm256_cmpgt_epi32(x0, k) : _mm256_cmpgt_epi32(k, x0);
+    __m256i m1 = Upper ? _mm256_cmpgt_epi32(x1, k) : _mm256_cmpgt_epi32(k, x1);
+    size_t count = (__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(m0))) +
+                    __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(m1)))) / 4;
+    return Upper ? 16 - count : count;
+}
+
+template<bool Upper>
+BST_TARGET_SSE42
+inline size_t rankBlock64Sse42(const int64_t* block, int64_t key, int64_t flip)
+{
+    __m128i k = _mm_set1_epi64x(key ^ flip);
+    __m128i f = _mm_set1_epi64x(flip);
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), f);
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 2)), f);
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 4)), f);
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 6)), f);
+    __m128i m0 = Upper ? _mm_cmpgt_epi64(x0, k) : _mm_cmpgt_epi64(k, x0);
+    __m128i m1 = Upper ? _mm_cmpgt_epi64(x1, k) : _mm_cmpgt_epi64(k, x1);
+    __m128i m2 = Upper ? _mm_cmpgt_epi64(x2, k) : _mm_cmpgt_epi64(k, x2);
+    __m128i m3 = Upper ? _mm_cmpgt_epi64(x3, k) : _mm_cmpgt_epi64(k, x3);
+    __m128i packed = _mm_packs_epi32(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+    size_t count = __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(packed))) / 2;
+    return Upper ? 8 - count : count;
+}
+
+template<bool Upper>
+BST_TARGET_AVX2
+inline size_t rankBlock64Avx2(const int64_t* block, int64_t key, int64_t flip)
+{
+    __m256i k = _mm256_set1_epi64x(key ^ flip);
+    __m256i f = _mm256_set1_epi64x(flip);
+    __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)), f);
+    __m256i x1 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 4)), f);
+    __m256i m0 = Upper ? _mm256_cmpgt_epi64(x0, k) : _mm256_cmpgt_epi64(k, x0);
+    __m256i m1 = Upper ? _mm256_cmpgt_epi64(x1, k) : _mm256_cmpgt_epi64(k, x1);
+    size_t count = (__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(m0))) +
+                    __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(m1)))) / 8;
+    return Upper ? 8 - count : count;
+}
+
+#endif
+
+/**
+* The integral specializations. Signed is the signed type of the same
+* width and Flip the value xor-ed into both sides of each comparison.
+* The SIMD members carry the target attribute too, so the block
+* comparison is inlined into them.
+*/
+template <typename Key, typename Signed, Signed Flip>
+struct IntegralBlockRank
+{
+    static const size_t WIDTH = 64 / sizeof(Key);
+    typedef size_t (*Function)(const Key* block, const Key& key);
+
+    static size_t scalarLower(const Key* block, const Key& key);
+    static size_t scalarUpper(const Key* block, const Key& key);
+    BST_TARGET_SSE42 static size_t sse42Lower(const Key* block, const Key& key);
+    BST_TARGET_SSE42 static size_t sse42Upper(const Key* block, const Key& key);
+    BST_TARGET_AVX2 static size_t avx2Lower(const Key* block, const Key& key);
+    BST_TARGET_AVX2 static size_t avx2Upper(const Key* block, const Key& key);
+    static Function lower(SearchKernel kernel);
+    static Function upper(SearchKernel kernel);
+};
+
+template<typename Key, typename Signed, Signed Flip>
+const size_t IntegralBlockRank<Key, Signed, Flip>::WIDTH;
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::scalarLower(const Key* block, const Key& key)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < WIDTH; i++){
+        count += (block[i] < key);
+    }
+    return count;
+}
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::scalarUpper(const Key* block, const Key& key)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < WIDTH; i++){
+        count += !(key < block[i]);
+    }
+    return count;
+}
+
+#ifdef BST_SIMD_X86
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::sse42Lower(const Key* block, const Key& key)
+{
+    if(sizeof(Key) == 4){
+        return rankBlock32Sse42<false>(reinterpret_cast<const int32_t*>(block), static_cast<int32_t>(key), static_cast<int32_t>(Flip));
+    }
+    return rankBlock64Sse42<false>(reinterpret_cast<const int64_t*>(block), static_cast<int64_t>(key), static_cast<int64_t>(Flip));
+}
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::sse42Upper(const Key* block, const Key& key)
+{
+    if(sizeof(Key) == 4){
+        return rankBlock32Sse42<true>(reinterpret_cast<const int32_t*>(block), static_cast<int32_t>(key), static_cast<int32_t>(Flip));
+    }
+    return rankBlock64Sse42<true>(reinterpret_cast<const int64_t*>(block), static_cast<int64_t>(key), static_cast<int64_t>(Flip));
+}
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::avx2Lower(const Key* block, const Key& key)
+{
+    if(sizeof(Key) == 4){
+        return rankBlock32Avx2<false>(reinterpret_cast<const int32_t*>(block), static_cast<int32_t>(key), static_cast<int32_t>(Flip));
+    }
+    return rankBlock64Avx2<false>(reinterpret_cast<const int64_t*>(block), static_cast<int64_t>(key), static_cast<int64_t>(Flip));
+}
+
+template<typename Key, typename Signed, Signed Flip>
+size_t IntegralBlockRank<Key, Signed, Flip>::avx2Upper(const Key* block, const Key& key)
+{
+    if(sizeof(Key) == 4){
+        return rankBlock32Avx2<true>(reinterpret_cast<const int32_t*>(block), static_cast<int32_t>(key), static_cast<int32_t>(Flip));
+    }
+    return rankBlock64Avx2<true>(reinterpret_cast<const int64_t*>(block), static_cast<int64_t>(key), static_cast<int64_t>(Flip));
+}
+
+#endif
+
+/**
+* Returns the lower kernel for the given instruction set, falling back
+* to the best one the CPU has if it lacks the one asked for.
+*/
+template<typename Key, typename Signed, Signed Flip>
+typename IntegralBlockRank<Key, Signed, Flip>::Function IntegralBlockRank<Key, Signed, Flip>::lower(SearchKernel kernel)
+{
+    if(kernel > bestSearchKernel()){
+        kernel = bestSearchKernel();
+    }
+#ifdef BST_SIMD_X86
+    if(kernel == AVX2_KERNEL){
+        return &avx2Lower;
+    }
+    if(kernel == SSE42_KERNEL){
+        return &sse42Lower;
+    }
+#endif
+    return &scalarLower;
+}
+
+template<typename Key, typename Signed, Signed Flip>
+typename IntegralBlockRank<Key, Signed, Flip>::Function IntegralBlockRank<Key, Signed, Flip>::upper(SearchKernel kernel)
+{
+    if(kernel > bestSearchKernel()){
+        kernel = bestSearchKernel();
+    }
+#ifdef BST_SIMD_X86
+    if(kernel == AVX2_KERNEL){
+        return &avx2Upper;
+    }
+    if(kernel == SSE42_KERNEL){
+        return &sse42Upper;
+    }
+#endif
+    return &scalarUpper;
+}
+
+template <>
+struct BlockRank<int32_t> : public IntegralBlockRank<int32_t, int32_t, 0> {};
+
+template <>
+struct BlockRank<uint32_t> : public IntegralBlockRank<uint32_t, int32_t, INT32_MIN> {};
+
+template <>
+struct BlockRank<int64_t> : public IntegralBlockRank<int64_t, int64_t, 0> {};
+
+template <>
+struct BlockRank<uint64_t> : public IntegralBlockRank<uint64_t, int64_t, INT64_MIN> {};
+
+#endif
@@ -0,0 +1,850 @@
+#ifndef STACKAVLBST_H
+#define STACKAVLBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "nodepool.h"
+
+/**
+* A node of a StackAVLTree: the item, two child pointers and the balance,
+* with no parent pointer. For int keys and values that is 32 bytes,
+* against 40 for an AVLNode.
+*/
+template <typename Key, typename Value>
+class StackAVLNode
+{
+public:
+    // Constructor/destructor.
+    StackAVLNode(const Key& key, const Value& value);
+    ~StackAVLNode();
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Value& getValue();
+    void setValue(const Value& value);
+
+    StackAVLNode<Key, Value>* getLeft() const;
+    StackAVLNode<Key, Value>* getRight() const;
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+
+protected:
+    // The tree rewires children through pointers to these links.
+    template<typename K, typename V> friend class StackAVLTree;
+
+    std::pair<const Key, Value> item_;
+    StackAVLNode<Key, Value>* left_;
+    StackAVLNode<Key, Value>* right_;
+    int8_t balance_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the StackAVLNode class.
+  ------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node is a leaf with balance 0.
+*/
+template<class Key, class Value>
+StackAVLNode<Key, Value>::StackAVLNode(const Key& key, const Value& value) :
+    item_(key, value),
+    left_(nullptr),
+    right_(nullptr),
+    balance_(0)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+StackAVLNode<Key, Value>::~StackAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& StackAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& StackAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& StackAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const Value& StackAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+Value& StackAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<class Key, class Value>
+StackAVLNode<Key, Value>* StackAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<class Key, class Value>
+StackAVLNode<Key, Value>* StackAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<class Key, class Value>
+int8_t StackAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the StackAVLNode class.
+  ----------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes have no parent pointer. Everything that would
+* walk up the tree uses a stack of the ancestors instead:
+*
+* - insert and remove record the links they descend through and retrace
+*   back up that stack.
+* - iterators carry the stack of ancestors still to be visited.
+*
+* An AVL tree of height h has at least F(h+2)-1 nodes (F being the
+* Fibonacci numbers), so MAX_HEIGHT = 64 covers any tree of fewer than
+* 2.7 * 10^13 nodes; the stacks are fixed arrays of that size. The price
+* is the iterator, which is about half a kilobyte.
+*
+* The iterator and lookup interface is the same as BinarySearchTree's.
+* The tree can be moved and swapped in O(1), but not copied.
+*/
+template <typename Key, typename Value>
+class StackAVLTree
+{
+protected:
+    typedef StackAVLNode<Key, Value> SNode;
+
+public:
+    static const int MAX_HEIGHT = 64;
+
+    StackAVLTree();
+    StackAVLTree(const StackAVLTree<Key, Value>& other) = delete;
+    StackAVLTree(StackAVLTree<Key, Value>&& other);
+    ~StackAVLTree();
+    StackAVLTree<Key, Value>& operator=(StackAVLTree<Key, Value> other);
+    void swap(StackAVLTree<Key, Value>& other);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+
+    /**
+    * An iterator over the tree in key order. It holds the current node on
+    * top of the ancestors whose left subtree it is in, which are the nodes
+    * still to be visited after it.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class StackAVLTree<Key, Value>;
+        void push(SNode* curr);
+        void pushLeft(SNode* curr);
+        SNode* current() const;
+
+        SNode* stack_[MAX_HEIGHT];
+        int depth_;
+    };
+
+    /**
+    * A [first, last) pair of iterators that can be walked with a
+    * range-based for loop; returned by range().
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    SNode* internalFind(const Key& key) const;
+    int subheight(SNode* curr) const;
+
+    SNode* createNode(const Key& key, const Value& value);
+    void destroyNode(SNode* curr);
+    void clearHelper(SNode* curr);
+
+    SNode* rebalance(SNode* prev, int8_t balance);
+    SNode* insertLeft(SNode* pare);
+    SNode* insertRight(SNode* pare);
+
+protected:
+    SNode* root_;
+    NodePool pool_;
+};
+
+template<class Key, class Value>
+const int StackAVLTree<Key, Value>::MAX_HEIGHT;
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the StackAVLTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value>
+StackAVLTree<Key, Value>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::iterator::push(SNode* curr)
+{
+    stack_[depth_++] = curr;
+}
+
+/**
+* Pushes curr and its chain of left descendants, ending on the smallest
+* node of curr's subtree.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::iterator::pushLeft(SNode* curr)
+{
+    while(curr != nullptr){
+        push(curr);
+        curr = curr->getLeft();
+    }
+}
+
+/**
+* The node the iterator is at, NULL for end().
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::iterator::current() const
+{
+    if(depth_ == 0){
+        return nullptr;
+    }
+    return stack_[depth_ - 1];
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& StackAVLTree<Key, Value>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* StackAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+/**
+* Two iterators are equal if they are at the same node.
+*/
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* The next node is the smallest one in the right subtree if there is one,
+* and otherwise the nearest ancestor left on the stack.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator& StackAVLTree<Key, Value>::iterator::operator++()
+{
+    SNode* curr = stack_[--depth_];
+    pushLeft(curr->getRight());
+    return (*this);
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the StackAVLTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::iterator_range::end() const
+{
+    return last_;
+}
+
+/**
+* Returns true if the range holds no items.
+*/
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::iterator_range::empty() const
+{
+    return first_ == last_;
+}
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StackAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value>
+StackAVLTree<Key, Value>::StackAVLTree() :
+    root_(nullptr)
+{
+
+}
+
+/**
+* Takes over other's nodes and their storage in O(1), leaving other empty.
+*/
+template<class Key, class Value>
+StackAVLTree<Key, Value>::StackAVLTree(StackAVLTree<Key, Value>&& other) :
+    root_(other.root_)
+{
+    other.root_ = nullptr;
+    pool_.swap(other.pool_);
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::~StackAVLTree()
+{
+    clear();
+}
+
+/**
+* Move assignment: other was built by the move constructor, so taking its
+* contents is a swap, and the old nodes go away with other.
+*/
+template<class Key, class Value>
+StackAVLTree<Key, Value>& StackAVLTree<Key, Value>::operator=(StackAVLTree<Key, Value> other)
+{
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1). Iterators stay valid and
+* now refer into the other tree.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::swap(StackAVLTree<Key, Value>& other)
+{
+    std::swap(root_, other.root_);
+    pool_.swap(other.pool_);
+}
+
+/**
+* Inserts keyValuePair, or overwrites the value if the key is already in
+* the tree. The descent records the link to each node it passes, and the
+* retrace walks that stack back up: each entry is where a rotated subtree
+* gets hung back, and whether the next entry is the node's left link says
+* which side grew.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    SNode** links[MAX_HEIGHT + 1];
+    int depth = 0;
+    SNode** link = &root_;
+    while((*link) != nullptr){
+        SNode* curr = *link;
+        if(keyValuePair.first == curr->getKey()){
+            curr->setValue(keyValuePair.second);
+            return;
+        }
+        links[depth++] = link;
+        link = (keyValuePair.first < curr->getKey()) ? &(curr->left_) : &(curr->right_);
+    }
+    *link = createNode(keyValuePair.first, keyValuePair.second);
+    links[depth] = link;
+
+    for(int i = depth - 1; i >= 0; i--){
+        SNode* curr = *links[i];
+        int8_t balance = curr->getBalance() + ((links[i + 1] == &(curr->left_)) ? -1 : 1);
+        if(balance == 0){
+            curr->setBalance(0);
+            return;
+        }
+        if((balance < -1) || (balance > 1)){
+            *links[i] = rebalance(curr, balance);
+            return;
+        }
+        curr->setBalance(balance);
+    }
+}
+
+/**
+* Removes the item with the given key, if any. A node with two children
+* is replaced by its predecessor, whose links are found by carrying on
+* down the same stack; then the retrace climbs from where the predecessor
+* was unlinked.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::remove(const Key& key)
+{
+    SNode** links[MAX_HEIGHT + 1];
+    int depth = 0;
+    SNode** link = &root_;
+    while(((*link) != nullptr) && !(key == (*link)->getKey())){
+        links[depth++] = link;
+        link = (key < (*link)->getKey()) ? &((*link)->left_) : &((*link)->right_);
+    }
+    SNode* curr = *link;
+    if(curr == nullptr){
+        return;
+    }
+    if((curr->getLeft() != nullptr) && (curr->getRight() != nullptr)){
+        int currDepth = depth;
+        links[depth++] = link;
+        SNode** predLink = &(curr->left_);
+        while((*predLink)->getRight() != nullptr){
+            links[depth++] = predLink;
+            predLink = &((*predLink)->right_);
+        }
+        SNode* pred = *predLink;
+        *predLink = pred->getLeft();
+        pred->left_ = curr->getLeft();
+        pred->right_ = curr->getRight();
+        pred->setBalance(curr->getBalance());
+        *link = pred;
+        // Links into curr now live in pred.
+        if(predLink == &(curr->left_)){
+            predLink = &(pred->left_);
+        }
+        if((depth > currDepth + 1) && (links[currDepth + 1] == &(curr->left_))){
+            links[currDepth + 1] = &(pred->left_);
+        }
+        link = predLink;
+    }
+    else{
+        *link = (curr->getLeft() != nullptr) ? curr->getLeft() : curr->getRight();
+    }
+    destroyNode(curr);
+    links[depth] = link;
+
+    for(int i = depth - 1; i >= 0; i--){
+        SNode* prev = *links[i];
+        int8_t balance = prev->getBalance() + ((links[i + 1] == &(prev->left_)) ? 1 : -1);
+        if((balance == -1) || (balance == 1)){
+            prev->setBalance(balance);
+            return;
+        }
+        if(balance == 0){
+            prev->setBalance(0);
+            continue;
+        }
+        SNode* heavy = (balance < 0) ? prev->getLeft() : prev->getRight();
+        bool evenChild = (heavy->getBalance() == 0);
+        *links[i] = rebalance(prev, balance);
+        if(evenChild){
+            return;
+        }
+    }
+}
+
+/**
+* Removes every item. When the nodes need no destructor their slabs are
+* released as a whole, as BinarySearchTree::clear does.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::clear()
+{
+#ifdef BST_HEAP_NODES
+    clearHelper(root_);
+#else
+    if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value){
+        clearHelper(root_);
+    }
+    pool_.release();
+#endif
+    root_ = nullptr;
+}
+
+/**
+* Frees the subtree at curr by rotating left children up, as
+* BinarySearchTree::clearHelper.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::clearHelper(SNode* curr)
+{
+    while(curr != nullptr){
+        SNode* left = curr->getLeft();
+        if(left != nullptr){
+            curr->left_ = left->getRight();
+            left->right_ = curr;
+            curr = left;
+        }
+        else{
+            SNode* right = curr->getRight();
+            destroyNode(curr);
+            curr = right;
+        }
+    }
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::isBalanced() const
+{
+    return subheight(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at curr, or -1 if any subtree in it
+* is out of balance.
+*/
+template<class Key, class Value>
+int StackAVLTree<Key, Value>::subheight(SNode* curr) const
+{
+    if(curr == nullptr){
+        return 0;
+    }
+    int left = subheight(curr->getLeft());
+    int right = subheight(curr->getRight());
+    if((left == -1) || (right == -1) || (left - right > 1) || (right - left > 1)){
+        return -1;
+    }
+    return ((left > right) ? left : right) + 1;
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeft(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Descends to key, stacking the nodes it leaves to the left; those are
+* exactly the ancestors still to be visited after the one found.
+*
+* The descents below write every node into the next stack slot and only
+* keep it (by bumping depth_) when going left, so that the step does not
+* branch on the comparison.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    SNode* curr = root_;
+    while((curr != nullptr) && !(key == curr->getKey())){
+        bool left = (key < curr->getKey());
+        it.stack_[it.depth_] = curr;
+        it.depth_ += left;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    if(curr == nullptr){
+        it.depth_ = 0;
+    }
+    else{
+        it.push(curr);
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+* Every node stacked is such an item, each smaller than the last, so the
+* top of the stack ends up at the first one.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    iterator it;
+    SNode* curr = root_;
+    while(curr != nullptr){
+        bool left = !(curr->getKey() < key);
+        it.stack_[it.depth_] = curr;
+        it.depth_ += left;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator StackAVLTree<Key, Value>::upper_bound(const Key& key) const
+{
+    iterator it;
+    SNode* curr = root_;
+    while(curr != nullptr){
+        bool left = (key < curr->getKey());
+        it.stack_[it.depth_] = curr;
+        it.depth_ += left;
+        curr = left ? curr->getLeft() : curr->getRight();
+    }
+    return it;
+}
+
+template<class Key, class Value>
+std::pair<typename StackAVLTree<Key, Value>::iterator, typename StackAVLTree<Key, Value>::iterator>
+StackAVLTree<Key, Value>::equal_range(const Key& key) const
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if((first != end()) && !(key < first->first)){
+        ++last;
+    }
+    return std::make_pair(first, last);
+}
+
+/**
+* Returns the items with lo <= key < hi; empty if hi <= lo.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator_range StackAVLTree<Key, Value>::range(const Key& lo, const Key& hi) const
+{
+    if(!(lo < hi)){
+        return iterator_range(end(), end());
+    }
+    return iterator_range(lower_bound(lo), lower_bound(hi));
+}
+
+template<class Key, class Value>
+Value& StackAVLTree<Key, Value>::operator[](const Key& key)
+{
+    SNode* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+Value const & StackAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    SNode* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    SNode* curr = root_;
+    while(curr != nullptr){
+        if(key == curr->getKey()){
+            break;
+        }
+        else if(key < curr->getKey()){
+            curr = curr->getLeft();
+        }
+        else{
+            curr = curr->getRight();
+        }
+    }
+    return curr;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::createNode(const Key& key, const Value& value)
+{
+#ifdef BST_HEAP_NODES
+    void* curr = ::operator new(sizeof(SNode));
+#else
+    void* curr = pool_.allocate(sizeof(SNode), alignof(SNode));
+#endif
+    return new (curr) SNode(key, value);
+}
+
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::destroyNode(SNode* curr)
+{
+    curr->~SNode();
+#ifdef BST_HEAP_NODES
+    ::operator delete(curr);
+#else
+    pool_.deallocate(curr);
+#endif
+}
+
+/**
+ * Rotates the subtree rooted at prev, whose balance is -2 or 2, back into
+ * AVL shape, as AVLTree::rebalance. Returns the new root of the subtree,
+ * which the caller hangs back from prev's old link.
+ */
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::rebalance(SNode* prev, int8_t balance)
+{
+    if(balance < 0){
+        SNode* curr = prev->getLeft();
+        if(curr->getBalance() <= 0){
+            insertLeft(prev);
+            if(curr->getBalance() == 0){
+                prev->setBalance(-1);
+                curr->setBalance(1);
+            }
+            else{
+                prev->setBalance(0);
+                curr->setBalance(0);
+            }
+            return curr;
+        }
+        SNode* next = curr->getRight();
+        prev->left_ = insertRight(curr);
+        insertLeft(prev);
+        curr->setBalance((next->getBalance() > 0) ? -1 : 0);
+        prev->setBalance((next->getBalance() < 0) ? 1 : 0);
+        next->setBalance(0);
+        return next;
+    }
+    SNode* curr = prev->getRight();
+    if(curr->getBalance() >= 0){
+        insertRight(prev);
+        if(curr->getBalance() == 0){
+            prev->setBalance(1);
+            curr->setBalance(-1);
+        }
+        else{
+            prev->setBalance(0);
+            curr->setBalance(0);
+        }
+        return curr;
+    }
+    SNode* next = curr->getLeft();
+    prev->right_ = insertLeft(curr);
+    insertRight(prev);
+    curr->setBalance((next->getBalance() < 0) ? 1 : 0);
+    prev->setBalance((next->getBalance() > 0) ? -1 : 0);
+    next->setBalance(0);
+    return next;
+}
+
+/**
+* Rotates right around pare and returns the new root of the subtree.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::insertLeft(SNode* pare)
+{
+    SNode* prev = pare->getLeft();
+    pare->left_ = prev->getRight();
+    prev->right_ = pare;
+    return prev;
+}
+
+/**
+* Rotates left around pare and returns the new root of the subtree.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::SNode* StackAVLTree<Key, Value>::insertRight(SNode* pare)
+{
+    SNode* prev = pare->getRight();
+    pare->right_ = prev->getLeft();
+    prev->left_ = pare;
+    return prev;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StackAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,640 @@
+#ifndef THREADEDAVLBST_H
+#define THREADEDAVLBST_H
+
+#include "avlbst.h"
+
+/**
+* An AVL node that also links to the nodes before and after it in key
+* order. Only ThreadedAVLTree uses this node, so other trees do not pay
+* for the two extra pointers.
+*/
+template <typename Key, typename Value>
+class ThreadedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    ThreadedAVLNode(const Key& key, const Value& value, ThreadedAVLNode<Key, Value>* parent);
+    template<typename... Args>
+    ThreadedAVLNode(ThreadedAVLNode<Key, Value>* parent, Args&&... args);
+    ~ThreadedAVLNode();
+
+    // Getters/setters for the in-order neighbours, NULL at either end.
+    ThreadedAVLNode<Key, Value>* getPrev() const;
+    ThreadedAVLNode<Key, Value>* getNext() const;
+    void setPrev(ThreadedAVLNode<Key, Value>* prev);
+    void setNext(ThreadedAVLNode<Key, Value>* next);
+
+    // Redefined for the same reason as in AVLNode.
+    ThreadedAVLNode<Key, Value>* getParent() const;
+    ThreadedAVLNode<Key, Value>* getLeft() const;
+    ThreadedAVLNode<Key, Value>* getRight() const;
+
+protected:
+    ThreadedAVLNode<Key, Value>* prev_;
+    ThreadedAVLNode<Key, Value>* next_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the ThreadedAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* An explicit constructor; a new node is not threaded yet.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::ThreadedAVLNode(const Key& key, const Value& value, ThreadedAVLNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(key, value, parent), prev_(nullptr), next_(nullptr)
+{
+
+}
+
+/**
+* Constructs the item in place; see Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+ThreadedAVLNode<Key, Value>::ThreadedAVLNode(ThreadedAVLNode<Key, Value> *parent, Args&&... args) :
+    AVLNode<Key, Value>(parent, std::forward<Args>(args)...), prev_(nullptr), next_(nullptr)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::~ThreadedAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getPrev() const
+{
+    return prev_;
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setPrev(ThreadedAVLNode<Key, Value>* prev)
+{
+    prev_ = prev;
+}
+
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setNext(ThreadedAVLNode<Key, Value>* next)
+{
+    next_ = next;
+}
+
+/**
+* Redefined so that callers get a ThreadedAVLNode back without a cast.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the ThreadedAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes are also threaded into a doubly linked list in
+* key order, so that an iterator steps to the next or previous item in
+* O(1) worst case instead of climbing parent pointers. The list only
+* depends on key order, which rotations and node swaps preserve, so the
+* rebalancing code does not touch it: a new leaf is spliced in next to
+* its parent by insertLeaf, removeNode splices a node out, and the bulk
+* operations (assign, copies, split, join and the set operations) repair
+* the links afterwards.
+*
+* The threads take two pointers of their own rather than the null child
+* links: every algorithm in BinarySearchTree and AVLTree reads links
+* through Node::getLeft and getRight, which would otherwise have to strip
+* a tag bit for every tree. That makes a node 16 bytes bigger. In
+* bst-bench, full scans run about 1.5x faster while the tree fits in
+* cache, and at a million keys, where each step waits on memory, about as
+* fast as AVLTree's.
+*/
+template <class Key, class Value>
+class ThreadedAVLTree : public AVLTree<Key, Value, std::less<Key>, ThreadedAVLTree<Key, Value> >
+{
+protected:
+    typedef AVLTree<Key, Value, std::less<Key>, ThreadedAVLTree<Key, Value> > Base;
+    typedef ThreadedAVLNode<Key, Value> ThreadedNode;
+    friend class BinarySearchTree<Key, Value>;
+    friend class AVLTree<Key, Value, std::less<Key>, ThreadedAVLTree<Key, Value> >;
+    typedef typename BinarySearchTree<Key, Value>::iterator BaseIterator;
+
+public:
+    /**
+    * An iterator over the tree that follows the threads.
+    */
+    class iterator : public BaseIterator
+    {
+    public:
+        iterator();
+        iterator(const BaseIterator& it);
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class ThreadedAVLTree<Key, Value>;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
+    /**
+    * Same as BinarySearchTree::iterator_range, with this tree's iterator.
+    */
+    class iterator_range
+    {
+    public:
+        iterator_range(const iterator& first, const iterator& last);
+
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    protected:
+        iterator first_;
+        iterator last_;
+    };
+
+    ThreadedAVLTree();
+    template<typename ForwardIt>
+    ThreadedAVLTree(ForwardIt first, ForwardIt last);
+    ThreadedAVLTree(const ThreadedAVLTree<Key, Value>& other);
+    ThreadedAVLTree(ThreadedAVLTree<Key, Value>&& other);
+    virtual ~ThreadedAVLTree();
+    ThreadedAVLTree<Key, Value>& operator=(ThreadedAVLTree<Key, Value> other);
+    ThreadedAVLTree<Key, Value> clone(unsigned int threads = 1) const;
+
+    iterator begin() const;
+    iterator end() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator_range range(const Key& lo, const Key& hi) const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+    template<typename InputIt>
+    void assignUnsorted(InputIt first, InputIt last);
+    void split(const Key& key, ThreadedAVLTree<Key, Value>& left, ThreadedAVLTree<Key, Value>& right);
+    void join(ThreadedAVLTree<Key, Value>& left, const std::pair<const Key, Value>& pivot, ThreadedAVLTree<Key, Value>& right);
+    void join(ThreadedAVLTree<Key, Value>& left, ThreadedAVLTree<Key, Value>& right);
+    void unionWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads = 1);
+    void intersectWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads = 1);
+    void differenceWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads = 1);
+
+protected:
+    Node<Key, Value>* insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* new_node);
+    void removeNode(Node<Key, Value>* node);
+    template<typename... Args>
+    Node<Key, Value>* createNode(Node<Key, Value>* parent, Args&&... args);
+    void destroyNode(Node<Key, Value>* curr);
+    static void link(Node<Key, Value>* prev, Node<Key, Value>* next);
+    void rethread();
+};
+
+/*
+---------------------------------------------------------------
+Begin implementations for the ThreadedAVLTree helper classes.
+---------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::iterator::iterator() : BaseIterator()
+{
+
+}
+
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::iterator::iterator(const BaseIterator& it) : BaseIterator(it)
+{
+
+}
+
+/**
+* Follows the thread to the next item: O(1) in the worst case.
+*/
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator&
+ThreadedAVLTree<Key, Value>::iterator::operator++()
+{
+    this->current_ = static_cast<ThreadedNode*>(this->current_)->getNext();
+    return (*this);
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Follows the thread back; from end() it finds the largest item as
+* BinarySearchTree::iterator does.
+*/
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator&
+ThreadedAVLTree<Key, Value>::iterator::operator--()
+{
+    if(this->current_ == nullptr){
+        BaseIterator::operator--();
+    }
+    else{
+        this->current_ = static_cast<ThreadedNode*>(this->current_)->getPrev();
+    }
+    return (*this);
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::iterator_range::iterator_range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::iterator_range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::iterator_range::end() const
+{
+    return last_;
+}
+
+template<class Key, class Value>
+bool ThreadedAVLTree<Key, Value>::iterator_range::empty() const
+{
+    return first_ == last_;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the ThreadedAVLTree helper classes.
+-------------------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::ThreadedAVLTree() : Base()
+{
+
+}
+
+/**
+* Builds the tree from a range sorted by strictly increasing key, in O(n).
+*/
+template<class Key, class Value>
+template<typename ForwardIt>
+ThreadedAVLTree<Key, Value>::ThreadedAVLTree(ForwardIt first, ForwardIt last) : Base()
+{
+    assign(first, last);
+}
+
+/**
+* A deep copy of other with the same shape, made once this tree's hooks
+* exist.
+*/
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::ThreadedAVLTree(const ThreadedAVLTree<Key, Value>& other) : Base()
+{
+    Base::cloneWith(*this, other, 1);
+    rethread();
+}
+
+/**
+* Takes over other's nodes, threads included, in O(1).
+*/
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::ThreadedAVLTree(ThreadedAVLTree<Key, Value>&& other) : Base(std::move(other))
+{
+
+}
+
+/**
+* Frees the nodes while this tree's hooks are still around.
+*/
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>::~ThreadedAVLTree()
+{
+    this->clear();
+}
+
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value>& ThreadedAVLTree<Key, Value>::operator=(ThreadedAVLTree<Key, Value> other)
+{
+    this->swap(other);
+    return *this;
+}
+
+/**
+* Returns a copy of the tree, as AVLTree::clone.
+*/
+template<class Key, class Value>
+ThreadedAVLTree<Key, Value> ThreadedAVLTree<Key, Value>::clone(unsigned int threads) const
+{
+    ThreadedAVLTree<Key, Value> copy;
+    Base::cloneWith(copy, *this, threads);
+    copy.rethread();
+    return copy;
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::begin() const
+{
+    return iterator(Base::begin());
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::end() const
+{
+    return iterator(Base::end());
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::reverse_iterator
+ThreadedAVLTree<Key, Value>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::reverse_iterator
+ThreadedAVLTree<Key, Value>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(Base::find(key));
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(Base::lower_bound(key));
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::upper_bound(const Key& key) const
+{
+    return iterator(Base::upper_bound(key));
+}
+
+template<class Key, class Value>
+std::pair<typename ThreadedAVLTree<Key, Value>::iterator, typename ThreadedAVLTree<Key, Value>::iterator>
+ThreadedAVLTree<Key, Value>::equal_range(const Key& key) const
+{
+    std::pair<BaseIterator, BaseIterator> found = Base::equal_range(key);
+    return std::make_pair(iterator(found.first), iterator(found.second));
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator_range
+ThreadedAVLTree<Key, Value>::range(const Key& lo, const Key& hi) const
+{
+    typename Base::iterator_range found = Base::range(lo, hi);
+    return iterator_range(iterator(found.begin()), iterator(found.end()));
+}
+
+/**
+* As AVLTree::erase, finding the next item by its thread.
+*/
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::erase(iterator pos)
+{
+    iterator next = pos;
+    ++next;
+    return iterator(Base::erase(pos, next));
+}
+
+template<class Key, class Value>
+typename ThreadedAVLTree<Key, Value>::iterator
+ThreadedAVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    return iterator(Base::erase(first, last));
+}
+
+/*
+ * The bulk operations build or regroup whole subtrees without going
+ * through insertLeaf or removeNode. Building is O(n) anyway, so the
+ * threads are simply laid again; split and join only cut or tie the
+ * list where the trees meet.
+ */
+template<class Key, class Value>
+template<typename ForwardIt>
+void ThreadedAVLTree<Key, Value>::assign(ForwardIt first, ForwardIt last)
+{
+    Base::assign(first, last);
+    rethread();
+}
+
+template<class Key, class Value>
+template<typename InputIt>
+void ThreadedAVLTree<Key, Value>::assignUnsorted(InputIt first, InputIt last)
+{
+    Base::assignUnsorted(first, last);
+    rethread();
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::split(const Key& key, ThreadedAVLTree<Key, Value>& left, ThreadedAVLTree<Key, Value>& right)
+{
+    Base::split(key, left, right);
+    link(left.getLargestNode(), nullptr);
+    link(nullptr, right.getSmallestNode());
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::join(ThreadedAVLTree<Key, Value>& left, const std::pair<const Key, Value>& pivot, ThreadedAVLTree<Key, Value>& right)
+{
+    Node<Key, Value>* last = left.getLargestNode();
+    Node<Key, Value>* first = right.getSmallestNode();
+    Base::join(left, pivot, right);
+    Node<Key, Value>* mid = this->internalFind(pivot.first);
+    link(last, mid);
+    link(mid, first);
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::join(ThreadedAVLTree<Key, Value>& left, ThreadedAVLTree<Key, Value>& right)
+{
+    Node<Key, Value>* last = left.getLargestNode();
+    Node<Key, Value>* first = right.getSmallestNode();
+    Base::join(left, right);
+    link(last, first);
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::unionWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads)
+{
+    Base::unionWith(other, threads);
+    rethread();
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::intersectWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads)
+{
+    Base::intersectWith(other, threads);
+    rethread();
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::differenceWith(ThreadedAVLTree<Key, Value>& other, unsigned int threads)
+{
+    Base::differenceWith(other, threads);
+    rethread();
+}
+
+/**
+* Links new_node as AVLTree::insertLeaf does, and splices it into the
+* list before rebalancing: a new left child comes just before its parent
+* and a new right child just after it.
+*/
+template<class Key, class Value>
+Node<Key, Value>* ThreadedAVLTree<Key, Value>::insertLeaf(Node<Key, Value>* parent, Node<Key, Value>* new_node)
+{
+    Node<Key, Value>* curr = BinarySearchTree<Key, Value>::linkLeaf(*this, parent, new_node);
+    if(parent == nullptr){
+        return curr;
+    }
+    ThreadedNode* above = static_cast<ThreadedNode*>(parent);
+    if(above->getLeft() == curr){
+        link(above->getPrev(), curr);
+        link(curr, above);
+    }
+    else{
+        link(curr, above->getNext());
+        link(above, curr);
+    }
+    this->insertFix(static_cast<AVLNode<Key, Value>*>(parent), static_cast<AVLNode<Key, Value>*>(curr));
+    return curr;
+}
+
+/**
+* Splices node out of the list, then removes it as AVLTree does. A node
+* with two children is swapped with its predecessor there, but nodes
+* keep their items and so their place in the list.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    if(node == nullptr){
+        return;
+    }
+    ThreadedNode* curr = static_cast<ThreadedNode*>(node);
+    link(curr->getPrev(), curr->getNext());
+    Base::removeNode(node);
+}
+
+template<class Key, class Value>
+template<typename... Args>
+Node<Key, Value>* ThreadedAVLTree<Key, Value>::createNode(Node<Key, Value>* parent, Args&&... args)
+{
+    return new (this->template allocateNode<ThreadedNode>()) ThreadedNode(static_cast<ThreadedNode*>(parent), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::destroyNode(Node<Key, Value>* curr)
+{
+    this->freeNode(static_cast<ThreadedNode*>(curr));
+}
+
+/**
+* Makes prev and next neighbours in the list; either may be NULL.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::link(Node<Key, Value>* prev, Node<Key, Value>* next)
+{
+    if(prev != nullptr){
+        static_cast<ThreadedNode*>(prev)->setNext(static_cast<ThreadedNode*>(next));
+    }
+    if(next != nullptr){
+        static_cast<ThreadedNode*>(next)->setPrev(static_cast<ThreadedNode*>(prev));
+    }
+}
+
+/**
+* Lays the threads again from the tree shape, in O(n).
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::rethread()
+{
+    Node<Key, Value>* prev = nullptr;
+    for(Node<Key, Value>* curr = this->getSmallestNode(); curr != nullptr; curr = this->successor(curr)){
+        link(prev, curr);
+        prev = curr;
+    }
+    link(prev, nullptr);
+}
+
+#endif